@@ -25,9 +25,6 @@
 #include "parse.h"
 #include "symtab.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 static void anlys_pgm(pgm_node_t *node);
 static void anlys_const_decf(const_dec_node_t *node);
 static void anlys_var_decf(var_dec_node_t *node);
@@ -113,7 +110,7 @@ static type_t infer_factor_type(factor_node_t *node) {
             idp = node->idp;
             e = symfind(idp->name);
             if (!e) {
-                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
             }
             return e->type;
         case ARRAY_FACTOR:
@@ -121,10 +118,10 @@ static type_t infer_factor_type(factor_node_t *node) {
             idp = node->idp;
             e = symfind(idp->name);
             if (!e) {
-                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
             }
             if (e->cate != ARRAY_OBJ) {
-                giveup(ERTYPE, "line %d: symbol %s type is not array.", idp->line, idp->name);
+                giveup(ERTYPE, "line %d: symbol %s type is not array.", idp->line, atom_str(idp->name));
             }
             return e->type;
         case UNSIGN_FACTOR:
@@ -143,15 +140,22 @@ static type_t infer_factor_type(factor_node_t *node) {
     return 0;
 }
 
-static void make_symkey(char *key, param_t *phead) {
+// overload key: name followed by the parameter types
+static atom_t make_symkey(atom_t name, param_t *phead) {
+    char key[MAXSTRLEN];
     param_t *p = NULL;
+    snprintf(key, MAXSTRLEN, "%s", atom_str(name));
     for (p = phead; p; p = p->next) {
-        strncat(key, typerepr[p->symbol->type], MAXSTRLEN - 1);
+        strncat(key, typerepr[p->symbol->type], MAXSTRLEN - 1 - strlen(key));
     }
+    return atom_cstr(key);
 }
 
-static void make_symkey2(char *key, arg_list_node_t *arglist, bool lit_utoi) {
+// overload key: name followed by the argument types
+static atom_t make_symkey2(atom_t name, arg_list_node_t *arglist, bool lit_utoi) {
+    char key[MAXSTRLEN];
     arg_list_node_t *a = NULL;
+    snprintf(key, MAXSTRLEN, "%s", atom_str(name));
     for (a = arglist; a; a = a->next) {
         type_t typ = infer_expr_type(a->ep);
         if (typ == LITERAL_TYPE) {
@@ -166,12 +170,13 @@ static void make_symkey2(char *key, arg_list_node_t *arglist, bool lit_utoi) {
             }
         }
 
-        strncat(key, typerepr[typ], MAXSTRLEN - 1);
+        strncat(key, typerepr[typ], MAXSTRLEN - 1 - strlen(key));
     }
+    return atom_cstr(key);
 }
 
 static void anlys_pgm(pgm_node_t *node) {
-    scope_entry(MAINFUNC);
+    scope_entry(atom_cstr(MAINFUNC));
 
     syment_t *e = syminit(node->entry);
     node->entry->symbol = e;
@@ -195,7 +200,7 @@ static void anlys_const_decf(const_dec_node_t *node) {
         ident_node_t *idp = t->cdp->idp;
         syment_t *e = symget(idp->name);
         if (e) {
-            rescue(DUPSYM, "line %d: const %s already declared.", idp->line, idp->name);
+            rescue(DUPSYM, "line %d: const %s already declared.", idp->line, atom_str(idp->name));
         } else {
             e = syminit(idp);
         }
@@ -212,7 +217,7 @@ static void anlys_var_decf(var_dec_node_t *node) {
             ident_node_t *idp = p->idp;
             syment_t *e = symget(idp->name);
             if (e) {
-                rescue(DUPSYM, "line %d: variable %s already declared.", idp->line, idp->name);
+                rescue(DUPSYM, "line %d: variable %s already declared.", idp->line, atom_str(idp->name));
             } else {
                 e = syminit(idp);
             }
@@ -272,13 +277,11 @@ static void anlys_proc_head(proc_head_node_t *node) {
     }
 
     // construct procedure name
-    char pname[MAXSTRLEN];
-    strncpy(pname, idp->name, MAXSTRLEN);
-    make_symkey(pname, phead);
+    atom_t pname = make_symkey(idp->name, phead);
 
     syment_t *e = symget2(parent, pname);
     if (e) {
-        rescue(DUPSYM, "line %d: procedure %s already declared.", idp->line, idp->name);
+        rescue(DUPSYM, "line %d: procedure %s already declared.", idp->line, atom_str(idp->name));
     } else {
         e = syminit2(parent, idp, pname);
     }
@@ -324,13 +327,11 @@ static void anlys_fun_head(fun_head_node_t *node) {
     }
 
     // construct function name
-    char fname[MAXSTRLEN];
-    strncpy(fname, idp->name, MAXSTRLEN);
-    make_symkey(fname, phead);
+    atom_t fname = make_symkey(idp->name, phead);
 
     syment_t *e = symget2(parent, fname);
     if (e) {
-        rescue(DUPSYM, "line %d: function %s already declared.", idp->line, idp->name);
+        rescue(DUPSYM, "line %d: function %s already declared.", idp->line, atom_str(idp->name));
     } else {
         e = syminit2(parent, idp, fname);
     }
@@ -351,7 +352,7 @@ static param_t* anlys_para_list(para_list_node_t *node) {
             ident_node_t *idp = p->idp;
             syment_t *e = symget(idp->name);
             if (e) {
-                rescue(DUPSYM, "line %d: parameter %s already declared.", idp->line, idp->name);
+                rescue(DUPSYM, "line %d: parameter %s already declared.", idp->line, atom_str(idp->name));
             } else {
                 e = syminit(idp);
             }
@@ -419,12 +420,12 @@ static void anlys_assign_stmt(assign_stmt_node_t *node) {
     syment_t *e;
     ident_node_t *idp = node->idp;
 
-    if (!strcmp(idp->name, scope_top()->nspace)) {
+    if (idp->name == scope_top()->nspace) {
         e = scope_top()->funcsym;
     } else {
         e = symfind(idp->name);
         if (!e) {
-            giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+            giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
         }
     }
 
@@ -466,7 +467,7 @@ static void anlys_for_stmt(for_stmt_node_t *node) {
     ident_node_t *idp = node->idp;
     syment_t *e = symfind(idp->name);
     if (!e) {
-        giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+        giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
     }
     idp->symbol = e;
 
@@ -484,23 +485,19 @@ static void anlys_pcall_stmt(pcall_stmt_node_t *node) {
     syment_t *e;
 
     ident_node_t *idp = node->idp;
-    char pname[MAXSTRLEN];
-
-    strncpy(pname, idp->name, MAXSTRLEN);
-    make_symkey2(pname, node->alp, false);
+    atom_t pname = make_symkey2(idp->name, node->alp, false);
     e = symfind(pname);
 
     if (!e) {
-        strncpy(pname, idp->name, MAXSTRLEN);
-        make_symkey2(pname, node->alp, true);
+        pname = make_symkey2(idp->name, node->alp, true);
         e = symfind(pname);
     }
 
     if (!e) {
-        giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+        giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
     }
     if (e->cate != PROC_OBJ) {
-        giveup(BADSYM, "line %d: procedure %s not found.", idp->line, idp->name);
+        giveup(BADSYM, "line %d: procedure %s not found.", idp->line, atom_str(idp->name));
     }
     idp->symbol = e;
 
@@ -516,7 +513,7 @@ static void anlys_read_stmt(read_stmt_node_t *node) {
         ident_node_t *idp = t->idp;
         syment_t *e = symfind(idp->name);
         if (!e) {
-            giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+            giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
         }
         idp->symbol = e;
     }
@@ -564,7 +561,7 @@ static void anlys_factor(factor_node_t *node) {
             idp = node->idp;
             e = symfind(idp->name);
             if (!e) {
-                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
             }
             switch (e->cate) {
                 case CONSTANT_OBJ:
@@ -574,7 +571,7 @@ static void anlys_factor(factor_node_t *node) {
                 case BY_REFERENCE_OBJ:
                     break;
                 default:
-                    giveup(BADCTG, "line %d: symbol %s category is bad.", idp->line, idp->name);
+                    giveup(BADCTG, "line %d: symbol %s category is bad.", idp->line, atom_str(idp->name));
             }
             idp->symbol = e;
             break;
@@ -583,10 +580,10 @@ static void anlys_factor(factor_node_t *node) {
             idp = node->idp;
             e = symfind(idp->name);
             if (!e) {
-                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+                giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
             }
             if (e->cate != ARRAY_OBJ) {
-                giveup(ERTYPE, "line %d: symbol %s type is not array.", idp->line, idp->name);
+                giveup(ERTYPE, "line %d: symbol %s type is not array.", idp->line, atom_str(idp->name));
             }
             idp->symbol = e;
 
@@ -617,23 +614,19 @@ static void anlys_fcall_stmt(fcall_stmt_node_t *node) {
     nevernil(node->idp);
 
     ident_node_t *idp = node->idp;
-    char fname[MAXSTRLEN];
-
-    strncpy(fname, idp->name, MAXSTRLEN);
-    make_symkey2(fname, node->alp, false);
+    atom_t fname = make_symkey2(idp->name, node->alp, false);
     e = symfind(fname);
 
     if (!e) {
-        strncpy(fname, idp->name, MAXSTRLEN);
-        make_symkey2(fname, node->alp, true);
+        fname = make_symkey2(idp->name, node->alp, true);
         e = symfind(fname);
     }
 
     if (!e) {
-        giveup(BADSYM, "line %d: function %s not found.", idp->line, idp->name);
+        giveup(BADSYM, "line %d: function %s not found.", idp->line, atom_str(idp->name));
     }
     if (e->cate != FUNCTION_OBJ) {
-        giveup(ERTYPE, "line %d: symbol %s type is not function.", idp->line, idp->name);
+        giveup(ERTYPE, "line %d: symbol %s type is not function.", idp->line, atom_str(idp->name));
     }
     idp->symbol = e;
 
@@ -691,18 +684,18 @@ static void anlys_arg_list(syment_t *sign, arg_list_node_t *node) {
                     goto refok;
                 }
 referr:
-                giveup(BADREF, "line %d: %s() arg%d has bad reference.", sign->lineno, sign->name, pos);
+                giveup(BADREF, "line %d: %s() arg%d has bad reference.", sign->lineno, atom_str(sign->name), pos);
                 continue;
 refok:
                 a = symfind(idp->name);
                 if (!a) {
-                    giveup(BADSYM, "line %d: symbol %s not found.", idp->line, idp->name);
+                    giveup(BADSYM, "line %d: symbol %s not found.", idp->line, atom_str(idp->name));
                 }
                 if (fp->kind == ID_FACTOR && a->cate != VARIABLE_OBJ) {
-                    giveup(OBJREF, "line %d: %s() arg%d is not variable object.", idp->line, idp->name, pos);
+                    giveup(OBJREF, "line %d: %s() arg%d is not variable object.", idp->line, atom_str(idp->name), pos);
                 }
                 if (fp->kind == ARRAY_FACTOR && a->cate != ARRAY_OBJ) {
-                    giveup(OBJREF, "line %d: %s() arg%d is not array object.", idp->line, idp->name, pos);
+                    giveup(OBJREF, "line %d: %s() arg%d is not array object.", idp->line, atom_str(idp->name), pos);
                 }
                 t->argsym = idp->symbol = a;
                 t->refsym = e;
@@ -713,7 +706,7 @@ refok:
     }
 
     if (t || p) {
-        giveup(BADLEN, "line %d: %s(...) arguments and parameters length not equal.", sign->lineno, sign->name);
+        giveup(BADLEN, "line %d: %s(...) arguments and parameters length not equal.", sign->lineno, atom_str(sign->name));
     }
 }
 
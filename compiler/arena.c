@@ -0,0 +1,107 @@
+/*
+ * @arena.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "global.h"
+
+// objects alignment
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+typedef struct _arena_block_struct arena_block_t;
+struct _arena_block_struct {
+    arena_block_t *next;
+    size_t size; // usable bytes
+    size_t used; // allocated bytes
+    max_align_t data[];
+};
+
+typedef struct _arena_struct {
+    arena_block_t *head; // current block
+    size_t used;         // bytes handed out
+    size_t reserved;     // bytes in blocks
+    int blocks;          // blocks
+} arena_state_t;
+
+static arena_state_t arenas[MAXARENA];
+
+static char *arena_names[] = {
+    "ast",    // AST_ARENA
+    "symtab", // SYMTAB_ARENA
+    "ir",     // IR_ARENA
+    "optim",  // OPTIM_ARENA
+    "asm",    // ASM_ARENA
+    "atom"    // ATOM_ARENA
+};
+
+void* arena_alloc(arena_t arena, size_t size) {
+    arena_state_t *a = &arenas[arena];
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    arena_block_t *b = a->head;
+    if (b == NULL || b->size - b->used < size) {
+        size_t bsize = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+        // blocks come zeroed and are never reused, so objects need no memset
+        b = calloc(1, sizeof(arena_block_t) + bsize);
+        if (b == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+        b->size = bsize;
+
+        // keep the block with more room as current
+        if (a->head && a->head->size - a->head->used > bsize - size) {
+            b->next = a->head->next;
+            a->head->next = b;
+        } else {
+            b->next = a->head;
+            a->head = b;
+        }
+        a->reserved += bsize;
+        ++a->blocks;
+    }
+
+    void *p = (char*) b->data + b->used;
+    b->used += size;
+    a->used += size;
+    return p;
+}
+
+void arena_release(arena_t arena) {
+    arena_state_t *a = &arenas[arena];
+
+    if (PL0E_OPT_VERBOSE) {
+        msg("; arena %-6s %8zu bytes used, %8zu reserved in %d blocks\n", arena_names[arena], a->used, a->reserved, a->blocks);
+    }
+
+    arena_block_t *b = a->head, *next;
+    while (b) {
+        next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+    a->used = a->reserved = 0;
+    a->blocks = 0;
+}
+
+size_t arena_used(arena_t arena) {
+    return arenas[arena].used;
+}
@@ -0,0 +1,151 @@
+/*
+ * @atom.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "atom.h"
+#include "debug.h"
+#include "global.h"
+
+// atom text, length and hash, indexed by atom
+static const char **atom_strs = NULL;
+static uint32_t *atom_lens = NULL;
+static uint32_t *atom_hashes = NULL;
+static uint32_t atoms_qty = 0;
+static uint32_t atoms_cap = 0;
+
+// open addressing index over atoms, slot holds atom + 1 (0 is empty)
+static uint32_t *slots = NULL;
+static uint32_t slots_qty = 0;
+
+// FNV-1a
+static uint32_t atom_hash(const char *s, uint32_t len) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void slots_grow(void) {
+    uint32_t qty = slots_qty ? slots_qty * 2 : 1024;
+    uint32_t *grown = calloc(qty, sizeof(uint32_t));
+    if (grown == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+
+    // atoms keep their hash, so rehashing never touches the text
+    for (uint32_t a = 0; a < atoms_qty; a++) {
+        uint32_t n = atom_hashes[a] & (qty - 1);
+        while (grown[n]) {
+            n = (n + 1) & (qty - 1);
+        }
+        grown[n] = a + 1;
+    }
+
+    free(slots);
+    slots = grown;
+    slots_qty = qty;
+}
+
+static atom_t atom_add(const char *s, uint32_t len, uint32_t h, uint32_t slot) {
+    if (atoms_qty == atoms_cap) {
+        atoms_cap = atoms_cap ? atoms_cap * 2 : 1024;
+        atom_strs = realloc(atom_strs, atoms_cap * sizeof(char*));
+        atom_lens = realloc(atom_lens, atoms_cap * sizeof(uint32_t));
+        atom_hashes = realloc(atom_hashes, atoms_cap * sizeof(uint32_t));
+        if (!atom_strs || !atom_lens || !atom_hashes) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+
+    // text never moves, atom_str() pointers stay valid
+    char *text = arena_alloc(ATOM_ARENA, len + 1);
+    memcpy(text, s, len);
+
+    atom_t a = atoms_qty++;
+    atom_strs[a] = text;
+    atom_lens[a] = len;
+    atom_hashes[a] = h;
+    slots[slot] = a + 1;
+    return a;
+}
+
+atom_t atom_intern(const char *s, uint32_t len) {
+    // keep the load factor under 1/2, the first atom is the empty string
+    if ((atoms_qty + 2) * 2 > slots_qty) {
+        slots_grow();
+        if (atoms_qty == 0) {
+            atom_add("", 0, atom_hash("", 0), atom_hash("", 0) & (slots_qty - 1));
+        }
+    }
+
+    uint32_t h = atom_hash(s, len);
+    uint32_t n = h & (slots_qty - 1);
+    while (slots[n]) {
+        atom_t a = slots[n] - 1;
+        if (atom_hashes[a] == h && atom_lens[a] == len && !memcmp(atom_strs[a], s, len)) {
+            return a;
+        }
+        n = (n + 1) & (slots_qty - 1);
+    }
+
+    return atom_add(s, len, h, n);
+}
+
+atom_t atom_cstr(const char *s) {
+    return atom_intern(s, strlen(s));
+}
+
+const char* atom_str(atom_t a) {
+    if (a >= atoms_qty) {
+        return "";
+    }
+    return atom_strs[a];
+}
+
+uint32_t atom_len(atom_t a) {
+    if (a >= atoms_qty) {
+        return 0;
+    }
+    return atom_lens[a];
+}
+
+uint32_t atom_qty(void) {
+    return atoms_qty;
+}
+
+void atom_free(void) {
+    if (PL0E_OPT_VERBOSE) {
+        msg("; atoms  %8u interned, %8u slots\n", atoms_qty, slots_qty);
+    }
+
+    free(atom_strs);
+    free(atom_lens);
+    free(atom_hashes);
+    free(slots);
+    atom_strs = NULL;
+    atom_lens = NULL;
+    atom_hashes = NULL;
+    slots = NULL;
+    atoms_qty = atoms_cap = slots_qty = 0;
+
+    arena_release(ATOM_ARENA);
+}
@@ -24,14 +24,11 @@
 #include "parse.h"
 #include "syntax.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 static int nextseq = 0;
 
 static tnode_t* initnode(int nid, char *name) {
     tnode_t *d;
-    INITMEM(tnode_t, d);
+    INITMEM(AST_ARENA, tnode_t, d);
     d->seq = ++nextseq;
     d->nid = nid;
     strcopy(d->name, name);
@@ -354,14 +351,14 @@ tnode_t* conv_write_stmt_node(write_stmt_node_t *t) {
     d->kind = t->type;
     switch (t->type) {
         case STR_WRITE:
-            sprintf(buf, "\\\"%s\\\"", t->sp);
+            sprintf(buf, "\\\"%s\\\"", atom_str(t->sp));
             strcopy(d->extra, buf);
             break;
         case ID_WRITE:
             addchild(d, conv_expr_node(t->ep), "ep");
             break;
         case STRID_WRITE:
-            sprintf(buf, "\\\"%s\\\"", t->sp);
+            sprintf(buf, "\\\"%s\\\"", atom_str(t->sp));
             strcopy(d->extra, buf);
             addchild(d, conv_expr_node(t->ep), "ep");
             break;
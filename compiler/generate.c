@@ -15,6 +15,8 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
+#include <stdint.h>
+
 #include "generate.h"
 #include "limits.h"
 #include "util.h"
@@ -25,6 +27,11 @@
 #include "symtab.h"
 #include "ir.h"
 
+// condition known at compile time
+typedef enum _cond_fold_enum {
+    COND_RUNTIME, COND_TRUE, COND_FALSE,
+} cond_fold_t;
+
 static void gen_pgm(pgm_node_t *node);
 static void gen_pf_dec_list(pf_dec_list_node_t *node);
 static void gen_proc_decf(proc_dec_node_t *node);
@@ -38,19 +45,190 @@ static void gen_for_stmt(for_stmt_node_t *node);
 static void gen_pcall_stmt(pcall_stmt_node_t *node);
 static void gen_read_stmt(read_stmt_node_t *node);
 static void gen_write_stmt(write_stmt_node_t *node);
-static syment_t* gen_expr(expr_node_t *node);
-static syment_t* gen_term(term_node_t *node);
-static syment_t* gen_factor(factor_node_t *node);
-static syment_t* gen_fcall_stmt(fcall_stmt_node_t *node);
-static void gen_cond(cond_node_t *node, syment_t *dest);
+static opnd_t gen_expr(expr_node_t *node);
+static opnd_t gen_term(term_node_t *node);
+static opnd_t gen_factor(factor_node_t *node);
+static opnd_t gen_fcall_stmt(fcall_stmt_node_t *node);
+static cond_fold_t gen_cond(cond_node_t *node, opnd_t label, bool holds);
 static void gen_arg_list(arg_list_node_t *node);
 
+////////////////////// folding /////////////////////////
+
+// At -O1 and up, operations on constants are done here and the result is
+// an immediate, and an operation with an identity operand gives the other
+// one. Folded values keep the type the operation gives, its left operand's,
+// so a write of the result prints the same. A variable is not given back
+// as it is, it would be read where the result is used, after calls later
+// in the expression that may write it.
+
+static bool isimm(opnd_t *o, long int v) {
+    return o->kind == IMM_OPND && o->imm == v;
+}
+
+// kept operand o stands for a result of type t
+static bool sametype(opnd_t *o, type_t t) {
+    return o->type == t || (t == LITERAL_TYPE && o->type == INT_TYPE);
+}
+
+// o holds its value until used, it can be given back as the result
+static bool keepable(opnd_t *o) {
+    return o->kind == IMM_OPND || o->kind == VREG_OPND;
+}
+
+// value v pushed as an immediate of type t is v, chars and unsigned are
+// pushed narrowed
+static bool fits(type_t t, long int v) {
+    switch (t) {
+        case CHAR_TYPE:
+            return v >= 0 && v <= UINT8_MAX;
+        case UINT_TYPE:
+            return v >= 0 && v <= INT32_MAX;
+        default:
+            return v >= INT32_MIN && v <= INT32_MAX;
+    }
+}
+
+// d = e op r at compile time, true if folded
+static bool fold(op_t op, opnd_t e, opnd_t r, opnd_t *d) {
+    if (!PL0E_OPT_LEVEL) {
+        return false;
+    }
+
+    if (e.kind == IMM_OPND && r.kind == IMM_OPND) {
+        long int v;
+        switch (op) {
+            case ADD_OP:
+                v = e.imm + r.imm;
+                break;
+            case SUB_OP:
+                v = e.imm - r.imm;
+                break;
+            case MUL_OP:
+                v = e.imm * r.imm;
+                break;
+            case DIV_OP:
+                // division by zero is left to the VM
+                if (r.imm == 0) {
+                    return false;
+                }
+                v = e.imm / r.imm;
+                break;
+            default:
+                return false;
+        }
+        // a value the immediate can't hold is computed by the VM
+        if (!fits(e.type, v)) {
+            return false;
+        }
+        *d = immopnd(v, e.type);
+        return true;
+    }
+
+    switch (op) {
+        case ADD_OP:
+            if (isimm(&r, 0) && keepable(&e)) {
+                *d = e;
+                return true;
+            }
+            if (isimm(&e, 0) && keepable(&r) && sametype(&r, e.type)) {
+                *d = r;
+                return true;
+            }
+            return false;
+        case SUB_OP:
+            if (isimm(&r, 0) && keepable(&e)) {
+                *d = e;
+                return true;
+            }
+            return false;
+        case MUL_OP:
+            // the operand is computed already, only its value is dropped
+            if (isimm(&e, 0) || isimm(&r, 0)) {
+                *d = immopnd(0, e.type);
+                return true;
+            }
+            if (isimm(&r, 1) && keepable(&e)) {
+                *d = e;
+                return true;
+            }
+            if (isimm(&e, 1) && keepable(&r) && sametype(&r, e.type)) {
+                *d = r;
+                return true;
+            }
+            return false;
+        case DIV_OP:
+            if (isimm(&r, 1) && keepable(&e)) {
+                *d = e;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// the relation false when kind is true
+static rela_t negrela(rela_t kind) {
+    switch (kind) {
+        case EQU_RELA:
+            return NEQ_RELA;
+        case NEQ_RELA:
+            return EQU_RELA;
+        case GTT_RELA:
+            return LEQ_RELA;
+        case GEQ_RELA:
+            return LST_RELA;
+        case LST_RELA:
+            return GEQ_RELA;
+        case LEQ_RELA:
+            return GTT_RELA;
+        default:
+            unlikely();
+            return kind;
+    }
+}
+
+// outcome of a condition of constants
+static cond_fold_t fold_cond(rela_t kind, opnd_t r, opnd_t s) {
+    if (!PL0E_OPT_LEVEL || r.kind != IMM_OPND || s.kind != IMM_OPND) {
+        return COND_RUNTIME;
+    }
+
+    bool taken;
+    switch (kind) {
+        case EQU_RELA:
+            taken = r.imm == s.imm;
+            break;
+        case NEQ_RELA:
+            taken = r.imm != s.imm;
+            break;
+        case GTT_RELA:
+            taken = r.imm > s.imm;
+            break;
+        case GEQ_RELA:
+            taken = r.imm >= s.imm;
+            break;
+        case LST_RELA:
+            taken = r.imm < s.imm;
+            break;
+        case LEQ_RELA:
+            taken = r.imm <= s.imm;
+            break;
+        default:
+            unlikely();
+            return COND_RUNTIME;
+    }
+    return taken ? COND_TRUE : COND_FALSE;
+}
+
+////////////////////////////////////////////////////////
+
 static void gen_pgm(pgm_node_t *node) {
     block_node_t *b = node->bp;
     gen_pf_dec_list(b->pfdlp);
 
     // main function
-    syment_t *entry = node->entry->symbol;
+    opnd_t entry = symopnd(node->entry->symbol);
     emit1(FN_START_OP, entry);
     gen_comp_stmt(b->csp);
     emit1(FN_END_OP, entry);
@@ -78,9 +256,9 @@ static void gen_proc_decf(proc_dec_node_t *node) {
         block_node_t *b = t->pdp->bp;
         gen_pf_dec_list(b->pfdlp);
 
-        emit1(FN_START_OP, t->pdp->php->idp->symbol);
+        emit1(FN_START_OP, symopnd(t->pdp->php->idp->symbol));
         gen_comp_stmt(b->csp);
-        emit1(FN_END_OP, t->pdp->php->idp->symbol);
+        emit1(FN_END_OP, symopnd(t->pdp->php->idp->symbol));
     }
 }
 
@@ -90,9 +268,9 @@ static void gen_fun_decf(fun_dec_node_t *node) {
         block_node_t *b = t->fdp->bp;
 
         gen_pf_dec_list(b->pfdlp);
-        emit1(FN_START_OP, t->fdp->fhp->idp->symbol);
+        emit1(FN_START_OP, symopnd(t->fdp->fhp->idp->symbol));
         gen_comp_stmt(b->csp);
-        emit1(FN_END_OP, t->fdp->fhp->idp->symbol);
+        emit1(FN_END_OP, symopnd(t->fdp->fhp->idp->symbol));
     }
 }
 
@@ -137,8 +315,8 @@ static void gen_stmt(stmt_node_t *node) {
 }
 
 static void gen_assign_stmt(assign_stmt_node_t *node) {
-    syment_t *r, *s, *d;
-    d = node->idp->symbol;
+    opnd_t r, s, d;
+    d = symopnd(node->idp->symbol);
     switch (node->kind) {
         case NORM_ASSGIN:
             r = gen_expr(node->rep);
@@ -159,11 +337,24 @@ static void gen_assign_stmt(assign_stmt_node_t *node) {
 }
 
 static void gen_if_stmt(if_stmt_node_t *node) {
-    syment_t *ifthen, *ifdone;
-    ifthen = symalloc(node->stab, "@ifthen", LABEL_OBJ, VOID_TYPE);
-    ifdone = symalloc(node->stab, "@ifdone", LABEL_OBJ, VOID_TYPE);
+    opnd_t ifthen, ifdone;
+    ifthen = labelopnd();
+    ifdone = labelopnd();
+
+    // only the arm a constant condition takes
+    switch (gen_cond(node->cp, ifthen, true)) {
+        case COND_TRUE:
+            gen_stmt(node->tp);
+            return;
+        case COND_FALSE:
+            if (node->ep) {
+                gen_stmt(node->ep);
+            }
+            return;
+        default:
+            break;
+    }
 
-    gen_cond(node->cp, ifthen);
     if (node->ep) {
         gen_stmt(node->ep);
     }
@@ -174,29 +365,65 @@ static void gen_if_stmt(if_stmt_node_t *node) {
 }
 
 static void gen_repe_stmt(repe_stmt_node_t *node) {
-    syment_t *loopstart, *loopdone;
-    loopstart = symalloc(node->stab, "@loopstart", LABEL_OBJ, VOID_TYPE);
-    loopdone = symalloc(node->stab, "@loopdone", LABEL_OBJ, VOID_TYPE);
+    opnd_t loopstart, loopdone;
+    loopstart = labelopnd();
+    loopdone = labelopnd();
 
     emit1(LABEL_OP, loopstart);
     gen_stmt(node->sp);
-    gen_cond(node->cp, loopdone);
-    emit1(JUMP_OP, loopstart);
-    emit1(LABEL_OP, loopdone);
+    if (!PL0E_OPT_LEVEL) {
+        gen_cond(node->cp, loopdone, true);
+        emit1(JUMP_OP, loopstart);
+        emit1(LABEL_OP, loopdone);
+        return;
+    }
+
+    // rotated, the exit test branches back while the condition fails
+    if (gen_cond(node->cp, loopstart, false) == COND_FALSE) {
+        emit1(JUMP_OP, loopstart);
+    }
+}
+
+// guarded do-while: a test before the loop, skipped when the bounds are
+// constant, and one at the bottom, so an iteration runs one branch. The
+// fix-up after the loop leaves d at the bound, as the top tested loop
+// does, and is dropped by LVA when d is dead
+static void gen_for_rotated(for_stmt_node_t *node, opnd_t d, opnd_t beg, opnd_t end, opnd_t forbody, opnd_t fordone) {
+    if (node->kind != TO_FOR && node->kind != DOWNTO_FOR) {
+        unlikely();
+    }
+    bool up = node->kind == TO_FOR;
+
+    cond_fold_t k = fold_cond(up ? GTT_RELA : LST_RELA, beg, end);
+    if (k == COND_RUNTIME) {
+        emit3(up ? BRANCH_GTT_OP : BRANCH_LST_OP, fordone, d, end);
+    }
+    if (k != COND_TRUE) {
+        emit1(LABEL_OP, forbody);
+        gen_stmt(node->sp);
+        emit1(up ? INC_OP : DEC_OP, d);
+        emit3(up ? BRANCH_LEQ_OP : BRANCH_GEQ_OP, forbody, d, end);
+    }
+    emit1(LABEL_OP, fordone);
+    emit1(up ? DEC_OP : INC_OP, d);
 }
 
 static void gen_for_stmt(for_stmt_node_t *node) {
-    syment_t *beg, *end;
+    opnd_t beg, end;
     beg = gen_expr(node->lep);
     end = gen_expr(node->rep);
 
-    syment_t *forstart, *fordone;
-    forstart = symalloc(node->stab, "@forstart", LABEL_OBJ, VOID_TYPE);
-    fordone = symalloc(node->stab, "@fordone", LABEL_OBJ, VOID_TYPE);
+    opnd_t forstart, fordone;
+    forstart = labelopnd();
+    fordone = labelopnd();
 
-    syment_t *d;
-    d = node->idp->symbol;
+    opnd_t d;
+    d = symopnd(node->idp->symbol);
     emit2(STORE_VAR_OP, d, beg);
+    if (PL0E_OPT_LEVEL) {
+        gen_for_rotated(node, d, beg, end, forstart, fordone);
+        return;
+    }
     emit1(LABEL_OP, forstart);
     switch (node->kind) {
         case TO_FOR:
@@ -222,19 +449,19 @@ static void gen_for_stmt(for_stmt_node_t *node) {
 
 static void gen_pcall_stmt(pcall_stmt_node_t *node) {
     gen_arg_list(node->alp);
-    emit2(CALL_OP, NULL, node->idp->symbol);
+    emit2(CALL_OP, NOOPND, symopnd(node->idp->symbol));
     arg_list_node_t *t;
     for (t = node->alp; t; t = t->next) {
-        emit1(POP_OP, NULL);
+        emit1(POP_OP, NOOPND);
     }
 }
 
 static void gen_read_stmt(read_stmt_node_t *node) {
     read_stmt_node_t *t;
-    syment_t *d = NULL;
+    opnd_t d;
     for (t = node; t; t = t->next) {
-        d = t->idp->symbol;
-        switch (d->type) {
+        d = symopnd(t->idp->symbol);
+        switch (d.type) {
             case CHAR_TYPE:
                 emit1(READ_CHAR_OP, d);
                 break;
@@ -250,16 +477,15 @@ static void gen_read_stmt(read_stmt_node_t *node) {
 }
 
 static void gen_write_stmt(write_stmt_node_t *node) {
-    syment_t *d = NULL;
+    opnd_t d;
     switch (node->type) {
         case STR_WRITE:
-            d = symalloc(node->stab, "@write/str", STRING_OBJ, STRING_TYPE);
-            strcopy(d->str, node->sp);
+            d = stropnd(node->stab, node->sp);
             emit1(WRITE_STRING_OP, d);
             break;
         case ID_WRITE:
             d = gen_expr(node->ep);
-            switch (d->type) {
+            switch (d.type) {
                 case CHAR_TYPE:
                     emit1(WRITE_CHAR_OP, d);
                     break;
@@ -277,11 +503,10 @@ static void gen_write_stmt(write_stmt_node_t *node) {
             }
             break;
         case STRID_WRITE:
-            d = symalloc(node->stab, "@write/str", STRING_OBJ, STRING_TYPE);
-            strcopy(d->str, node->sp);
+            d = stropnd(node->stab, node->sp);
             emit1(WRITE_STRING_OP, d);
             d = gen_expr(node->ep);
-            switch (d->type) {
+            switch (d.type) {
                 case CHAR_TYPE:
                     emit1(WRITE_CHAR_OP, d);
                     break;
@@ -300,23 +525,22 @@ static void gen_write_stmt(write_stmt_node_t *node) {
     }
 }
 
-static syment_t* gen_expr(expr_node_t *node) {
+static opnd_t gen_expr(expr_node_t *node) {
     expr_node_t *t;
-    syment_t *d, *r, *e;
-    d = r = e = NULL;
+    opnd_t d, r, e;
+    d = r = e = NOOPND;
     for (t = node; t; t = t->next) {
         r = gen_term(t->tp);
 
-        if (!d) {
+        if (!HASOPND(d)) {
             switch (t->kind) {
                 case NEG_ADDOP:
-                    if (r->type == LITERAL_TYPE) {
-                        d = symalloc(node->stab, "@expr/neg", NUMBER_OBJ, LITERAL_TYPE);
-                        d->type = LITERAL_TYPE;
-                        d->cate = NUMBER_OBJ;
-                        d->initval = -r->initval;
+                    if (r.type == LITERAL_TYPE) {
+                        d = immopnd(-opndval(&r), LITERAL_TYPE);
+                    } else if (PL0E_OPT_LEVEL && r.kind == IMM_OPND && fits(r.type, -r.imm)) {
+                        d = immopnd(-r.imm, r.type);
                     } else {
-                        d = symalloc(node->stab, "@expr/neg", TEMP_OBJ, r->type);
+                        d = vregopnd(node->stab, "@expr/neg", r.type);
                         emit2(NEG_OP, d, r);
                     }
                     break;
@@ -333,13 +557,19 @@ static syment_t* gen_expr(expr_node_t *node) {
             case NOP_ADDOP:
             case ADD_ADDOP:
                 e = d;
-                d = symalloc(node->stab, "@expr/add", TEMP_OBJ, e->type);
+                if (fold(ADD_OP, e, r, &d)) {
+                    break;
+                }
+                d = vregopnd(node->stab, "@expr/add", e.type);
                 emit3(ADD_OP, d, e, r);
                 break;
             case MINUS_ADDOP:
             case NEG_ADDOP:
                 e = d;
-                d = symalloc(node->stab, "@expr/sub", TEMP_OBJ, e->type);
+                if (fold(SUB_OP, e, r, &d)) {
+                    break;
+                }
+                d = vregopnd(node->stab, "@expr/sub", e.type);
                 emit3(SUB_OP, d, e, r);
                 break;
             default:
@@ -349,13 +579,13 @@ static syment_t* gen_expr(expr_node_t *node) {
     return d;
 }
 
-static syment_t* gen_term(term_node_t *node) {
+static opnd_t gen_term(term_node_t *node) {
     term_node_t *t;
-    syment_t *d, *r, *e;
-    d = r = e = NULL;
+    opnd_t d, r, e;
+    d = r = e = NOOPND;
     for (t = node; t; t = t->next) {
         r = gen_factor(t->fp);
-        if (!d) {
+        if (!HASOPND(d)) {
             if (t->kind != NOP_MULTOP) {
                 unlikely();
             }
@@ -366,12 +596,18 @@ static syment_t* gen_term(term_node_t *node) {
             case NOP_MULTOP:
             case MULT_MULTOP:
                 e = d;
-                d = symalloc(node->stab, "@term/mul", TEMP_OBJ, e->type);
+                if (fold(MUL_OP, e, r, &d)) {
+                    break;
+                }
+                d = vregopnd(node->stab, "@term/mul", e.type);
                 emit3(MUL_OP, d, e, r);
                 break;
             case DIV_MULTOP:
                 e = d;
-                d = symalloc(node->stab, "@term/div", TEMP_OBJ, e->type);
+                if (fold(DIV_OP, e, r, &d)) {
+                    break;
+                }
+                d = vregopnd(node->stab, "@term/div", e.type);
                 emit3(DIV_OP, d, e, r);
                 break;
             default:
@@ -381,26 +617,28 @@ static syment_t* gen_term(term_node_t *node) {
     return d;
 }
 
-static syment_t* gen_factor(factor_node_t *node) {
-    syment_t *d, *r, *e;
-    d = r = e = NULL;
+static opnd_t gen_factor(factor_node_t *node) {
+    opnd_t d, r, e;
+    d = r = e = NOOPND;
     switch (node->kind) {
         case ID_FACTOR:
-            d = node->idp->symbol;
+            d = symopnd(node->idp->symbol);
+            // a const is its value
+            if (PL0E_OPT_LEVEL && d.sym->cate == CONSTANT_OBJ) {
+                d = immopnd(d.sym->initval, d.type);
+            }
             break;
         case ARRAY_FACTOR:
-            r = node->idp->symbol;
+            r = symopnd(node->idp->symbol);
             e = gen_expr(node->ep);
-            d = symalloc(node->stab, "@factor/array", TEMP_OBJ, r->type);
+            d = vregopnd(node->stab, "@factor/array", r.type);
             emit3(LOAD_ARRAY_OP, d, r, e);
             break;
         case UNSIGN_FACTOR:
-            d = symalloc(node->stab, "@factor/usi", NUMBER_OBJ, LITERAL_TYPE);
-            d->initval = node->value;
+            d = immopnd(node->value, LITERAL_TYPE);
             break;
         case CHAR_FACTOR:
-            d = symalloc(node->stab, "@factor/char", NUMBER_OBJ, CHAR_TYPE);
-            d->initval = node->value;
+            d = immopnd(node->value, CHAR_TYPE);
             break;
         case EXPR_FACTOR:
             d = gen_expr(node->ep);
@@ -414,24 +652,32 @@ static syment_t* gen_factor(factor_node_t *node) {
     return d;
 }
 
-static syment_t* gen_fcall_stmt(fcall_stmt_node_t *node) {
-    syment_t *d, *e;
-    e = node->idp->symbol;
-    d = symalloc(node->stab, "@fcall/ret", TEMP_OBJ, e->type);
+static opnd_t gen_fcall_stmt(fcall_stmt_node_t *node) {
+    opnd_t d, e;
+    e = symopnd(node->idp->symbol);
+    d = vregopnd(node->stab, "@fcall/ret", e.type);
     gen_arg_list(node->alp);
     emit2(CALL_OP, d, e);
     arg_list_node_t *t;
     for (t = node->alp; t; t = t->next) {
-        emit1(POP_OP, NULL);
+        emit1(POP_OP, NOOPND);
     }
     return d;
 }
 
-static void gen_cond(cond_node_t *node, syment_t *label) {
-    syment_t *r, *s;
+// branch to label when the condition evaluates to `holds`. A condition
+// of constants emits no branch, its outcome is returned
+static cond_fold_t gen_cond(cond_node_t *node, opnd_t label, bool holds) {
+    opnd_t r, s;
     r = gen_expr(node->lep);
     s = gen_expr(node->rep);
-    switch (node->kind) {
+
+    cond_fold_t k = fold_cond(node->kind, r, s);
+    if (k != COND_RUNTIME) {
+        return k;
+    }
+
+    switch (holds ? node->kind : negrela(node->kind)) {
         case EQU_RELA:
             emit3(BRANCH_EQU_OP, label, r, s);
             break;
@@ -451,6 +697,7 @@ static void gen_cond(cond_node_t *node, syment_t *label) {
             emit3(BRANCH_LEQ_OP, label, r, s);
             break;
     }
+    return COND_RUNTIME;
 }
 
 static void gen_arg_list(arg_list_node_t *node) {
@@ -462,17 +709,17 @@ static void gen_arg_list(arg_list_node_t *node) {
     // Push arguments in reverse order
     gen_arg_list(t->next);
 
-    syment_t *d = NULL, *r = NULL;
+    opnd_t d, r;
     switch (t->refsym->cate) {
         case BY_VALUE_OBJ:
             d = gen_expr(t->ep);
             emit1(PUSH_VAL_OP, d);
             break;
         case BY_REFERENCE_OBJ:
-            d = t->argsym;
+            d = symopnd(t->argsym);
             switch (t->argsym->cate) {
                 case VARIABLE_OBJ:
-                    emit2(PUSH_ADDR_OP, d, NULL);
+                    emit2(PUSH_ADDR_OP, d, NOOPND);
                     break;
                 case ARRAY_OBJ:
                     r = gen_expr(t->idx);
@@ -0,0 +1,45 @@
+/*
+ * @arena.h
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// Memory arenas, one for each compiling phase. Objects are bump allocated,
+// zero filled and released all together once the phase consumers are done.
+typedef enum _arena_enum {
+    AST_ARENA,    // 0x00 syntax tree
+    SYMTAB_ARENA, // 0x01 symbol tables, entries and parameters
+    IR_ARENA,     // 0x02 intermediate representation
+    OPTIM_ARENA,  // 0x03 flow graph, DAG and data flow sets
+    ASM_ARENA,    // 0x04 target code generation
+    ATOM_ARENA,   // 0x05 interned strings
+    MAXARENA      //
+} arena_t;
+
+// default block size, bigger objects get a block of their own
+#define ARENA_BLOCK (64 * 1024)
+
+// allocate size zeroed bytes from arena
+void* arena_alloc(arena_t arena, size_t size);
+// release every object of arena
+void arena_release(arena_t arena);
+// bytes used by arena since the last release
+size_t arena_used(arena_t arena);
+
+#endif /* _ARENA_H_ */
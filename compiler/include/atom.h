@@ -0,0 +1,44 @@
+/*
+ * @atom.h
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#ifndef _ATOM_H_
+#define _ATOM_H_
+
+#include <stdint.h>
+
+// Interned strings. Identifiers, labels, namespaces and string constants
+// are hashed once and then passed around as 32-bit atoms, two strings are
+// equal if and only if their atoms are.
+typedef uint32_t atom_t;
+
+// atom of the empty string
+#define NOATOM 0
+
+// atom of s[0..len)
+atom_t atom_intern(const char *s, uint32_t len);
+// atom of NUL terminated s
+atom_t atom_cstr(const char *s);
+// NUL terminated text of atom a, valid until atom_free()
+const char* atom_str(atom_t a);
+// length of atom a
+uint32_t atom_len(atom_t a);
+// atoms interned
+uint32_t atom_qty(void);
+// release every atom
+void atom_free(void);
+
+#endif /* _ATOM_H_ */
@@ -20,19 +20,12 @@
 
 #include <stdint.h>
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
+#include "arena.h"
 
-// Initialize struct, allocate memory
-//     INITMEM(s: struct, v: variable, struct pointer)
-#define INITMEM(s, v)                                                     \
-		v = (s*)calloc(1, sizeof(s));                                     \
-		memtrack = realloc(memtrack, (memtrack_qty + 1) * sizeof(void*)); \
-		memtrack[memtrack_qty] = (void*)v;                                \
-		++memtrack_qty;                                                   \
-		if (v == NULL) {                                                  \
-			panic("OUT_OF_MEMORY");                                       \
-		}
+// Initialize struct, allocate zeroed memory from a phase arena
+//     INITMEM(a: arena, s: struct, v: variable, struct pointer)
+#define INITMEM(a, s, v) \
+		v = (s*)arena_alloc(a, sizeof(s))
 
 // Compiling Phase
 typedef enum _phase_enum {
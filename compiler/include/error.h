@@ -25,6 +25,7 @@
 #define ERTYPE 113
 #define BADLEN 114
 #define BADREF 115
+#define TOOBIG 116
 #define OBJREF 106
 #define ENOCMD 995
 #define EPANIC 996
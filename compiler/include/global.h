@@ -37,7 +37,15 @@ extern char PL0E_OBJECT[];
 extern char PL0E_TARGET[];
 
 // option
+extern bool PL0E_OPT_VERBOSE;
 extern bool PL0E_OPT_SET_TARGET_NAME;
+extern bool PL0E_OPT_LEX_BENCH;
+extern bool PL0E_OPT_SYMTAB_BENCH;
+extern bool PL0E_OPT_IR_BENCH;
+extern bool PL0E_OPT_BITS_BENCH;
+extern int PL0E_OPT_LEVEL;
+// callee size inlined at any call site, -1 for the -O level default
+extern int PL0E_OPT_INLINE_LIMIT;
 
 // print control
 extern bool echo;
@@ -58,9 +66,6 @@ extern FILE *asmble;
 #define MAINFUNC "_start"
 
 // Lexical
-// hold source file line buffer in scan.c
-extern char linebuf[MAXLINEBUF];
-extern int bufsize;
 token_t gettok(void);
 
 #endif /* _GLOBAL_H_ */
@@ -72,32 +72,73 @@ typedef enum _inst_op_enum {
     LABEL_OP   // 0x1e ifthen / ifdone / loopstart / loopdone / forstart / fordone
 } op_t;
 
+// Operand kind
+typedef enum _opnd_kind_enum {
+    NONE_OPND,  // 0x00 absent
+    SYM_OPND,   // 0x01 program symbol
+    IMM_OPND,   // 0x02 immediate constant
+    VREG_OPND,  // 0x03 virtual register, expression temporary
+    LABEL_OPND, // 0x04 jump target
+    STR_OPND,   // 0x05 string constant
+} opnd_kind_t;
+
+// Instruction operand, by value. Only SYM_OPND refers to the symbol
+// table, the other kinds are numbered from the sid sequence so an id
+// names any operand of the program.
+typedef struct _opnd_struct {
+    opnd_kind_t kind : 8; //
+    type_t type : 8;      //
+    int id;               // sid for SYM_OPND
+    union {
+        syment_t *sym;    // SYM_OPND
+        long int imm;     // IMM_OPND
+    };
+} opnd_t;
+
+#define NOOPND      ((opnd_t) { .kind = NONE_OPND })
+#define HASOPND(o)  ((o).kind != NONE_OPND)
+
 // Instruction struct
 typedef struct _inst_struct inst_t;
 
 struct _inst_struct {
     int xid;
     op_t op;
-    syment_t *d;
-    syment_t *r;
-    syment_t *s;
-    inst_t *prev;
-    inst_t *next;
+    opnd_t d;
+    opnd_t r;
+    opnd_t s;
 };
 
 // Constructor
-#define NEWINST(v) INITMEM(inst_t, v)
+#define NEWINST(v) INITMEM(IR_ARENA, inst_t, v)
 
-// hold instructions
-extern inst_t *xhead;
-extern inst_t *xtail;
+// hold instructions, insts[0..instqty-1] in emit order
+extern inst_t *insts;
+extern int instqty;
 
 // opcode table
 extern char *opcode[32];
 
-// emit an instruction
-inst_t* emit1(op_t op, syment_t *d);
-inst_t* emit2(op_t op, syment_t *d, syment_t *r);
-inst_t* emit3(op_t op, syment_t *d, syment_t *r, syment_t *s);
+// operand constructors
+opnd_t symopnd(syment_t *e);
+opnd_t immopnd(long int value, type_t type);
+opnd_t vregopnd(symtab_t *stab, char *name, type_t type);
+opnd_t labelopnd(void);
+opnd_t stropnd(symtab_t *stab, atom_t str);
+
+// operand attributes, as the symbol category they stand for
+cate_t opndcate(opnd_t *o);
+long int opndval(opnd_t *o);
+const char* opndlabel(opnd_t *o);
+
+// emit an instruction, the pointer is valid until the next emit
+inst_t* emit1(op_t op, opnd_t d);
+inst_t* emit2(op_t op, opnd_t d, opnd_t r);
+inst_t* emit3(op_t op, opnd_t d, opnd_t r, opnd_t s);
+// take the instruction vector out, the caller frees it. The IR is empty
+// afterwards and emit starts a new vector
+inst_t* ir_detach(void);
+// release the instruction vector
+void ir_free(void);
 
 #endif /* _IR_H_ */
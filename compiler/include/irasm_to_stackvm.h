@@ -18,6 +18,76 @@
 #ifndef IRASM_TO_STACKVM_H_
 #define IRASM_TO_STACKVM_H_
 
-void irasm_to_stackvm(asm_result_t *irasm, uint32_t irasm_len, asm_result_t **stackvm_asm, uint32_t *stackvm_asm_len);
+#include <stdint.h>
+
+#include "irassembler.h"
+
+// Program image
+//
+//   header (little endian)
+//     u8[4] magic "SVMP"
+//     u32   entry pc
+//     u32   globals used
+//     u32   program length
+//   program
+//     code, followed by the string constants (NUL terminated)
+//
+// Storage model
+//
+//   - CALL reserves u8 locals (return value, variables and temporaries) on
+//     top of the pushed arguments. Locals are numbered from the top of the
+//     frame down: reserved locals are 0..u8-1, then the arguments, first
+//     argument (pushed last) first. RETURN/RETURN_VALUE discard the reserved
+//     locals and the caller drops the arguments (IR POP).
+//   - binary operators compute second OP top.
+//   - at -O1 and up a temporary written and read once in a block stays on
+//     the operand stack when nothing between leaves it off the top.
+//     Other temporaries share locals (globals in the main program) by live
+//     range, after the variables.
+//   - global 0 holds the memory array (MEM). Arrays, variables passed by
+//     reference and variables referenced from nested scopes live in MEM,
+//     and their address is the MEM index.
+//   - those of a recursive function (one in a cycle of the call graph) live
+//     in a frame pushed on a stack of STACKVM_MEMSTACK cells above the
+//     static ones on entry and popped on return. A global per function,
+//     the display, holds the frame base of its last activation, which is
+//     the one its nested procedures see. Recursion deeper than the stack
+//     holds halts with code STACKVM_HALT_MEMSTACK.
+//   - variables of the main program live in globals 1..n.
+//   - global 0xffffffff is the indirect register, GET_ARRAY_VALUE and
+//     SET_ARRAY_VALUE with index 0xffff use it. Both pop the array first,
+//     SET_ARRAY_VALUE then pops the value.
+//   - I/O goes through LIB_FN, u8 count of arguments popped from the stack
+//     then u32 library function (STACKVM_LIB_*).
+
+#define STACKVM_MAGIC      "SVMP"
+#define STACKVM_MEMREF     0
+#define STACKVM_INDIRECT   0xffffffff
+#define STACKVM_INDIRECT16 0xffff
+
+#define STACKVM_MEMSTACK      4096 // MEM cells for recursive frames, at most
+#define STACKVM_HALT_MEMSTACK 1    // HALT code on MEM frame stack overflow
+
+// library functions
+enum STACKVM_LIB {
+    STACKVM_LIB_READ_INT,     // 0x00
+    STACKVM_LIB_READ_UINT,    // 0x01
+    STACKVM_LIB_READ_CHAR,    // 0x02
+    STACKVM_LIB_WRITE_STRING, // 0x03
+    STACKVM_LIB_WRITE_INT,    // 0x04
+    STACKVM_LIB_WRITE_UINT,   // 0x05
+    STACKVM_LIB_WRITE_CHAR,   // 0x06
+};
+
+typedef struct stackvm_program_s {
+     uint8_t *program;
+    uint32_t program_len;
+    uint32_t entry;
+    uint32_t globals;
+} stackvm_program_t;
+
+void irasm_to_stackvm(asm_result_t *irasm, uint32_t irasm_len, stackvm_program_t *program);
+void stackvm_write(stackvm_program_t *program, char *path);
+void stackvm_free(stackvm_program_t *program);
 
 #endif /* IRASM_TO_STACKVM_H_ */
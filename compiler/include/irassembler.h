@@ -18,37 +18,46 @@
 #ifndef _IRASSEMBLER_H_
 #define _IRASSEMBLER_H_
 
-#define MAXSTRINGLEN 8192
+#include <stdint.h>
+#include <stdbool.h>
+
+// max operands in one irasm record
+#define IRASM_MAXARGS 7
+
+// string table index (labels, names and string constants)
+typedef uint32_t irasm_str_t;
 
 typedef struct fn_ir_args_s {
-       char label[1024];
-       char name[1024];
-    uint8_t category;
-    uint8_t type;
+    irasm_str_t label;
+    irasm_str_t name;
+        uint8_t category;
+        uint8_t type;
 } fn_ir_args_t;
 
 typedef struct fn_ir_locales_s {
-       char label[1024];
-       char name[1024];
-    uint8_t category;
-    uint8_t type;
+    irasm_str_t label;
+    irasm_str_t name;
+        uint8_t category;
+        uint8_t type;
+       uint32_t length; // array length
 } fn_ir_locales_t;
 
 typedef struct fn_ir_temps_s {
-       char label[1024];
-       char name[1024];
-    uint8_t category;
-    uint8_t type;
+    irasm_str_t label;
+    irasm_str_t name;
+        uint8_t category;
+        uint8_t type;
 } fn_ir_temps_t;
 
 typedef struct fn_ir_strings_s {
-    char label[1024];
-    char value[MAXSTRINGLEN];
+    irasm_str_t label;
+    irasm_str_t value;
 } fn_ir_strings_t;
 
 typedef struct fn_ir_elements_s {
-             char name[1024];
-             char label[1024];
+         irasm_str_t name;
+         irasm_str_t label;
+             uint8_t category; // procedure or function
 
         fn_ir_args_t *args;
      fn_ir_locales_t *locales;
@@ -62,30 +71,32 @@ typedef struct fn_ir_elements_s {
          long int strings_qty;
 } fn_ir_elements_t;
 
-typedef struct irasm_argument_s {
-    bool type; // number, str
-    union {
-        long int number;
-            char str[MAXSTRINGLEN];
-    } value;
+// operand: a number or an index into the irasm string table
+typedef union irasm_argument_u {
+        int32_t number;
+    irasm_str_t str;
 } irasm_argument_t;
 
+// fixed size, pointer-free irasm record (32 bytes)
 typedef struct irasm_result_s {
              uint8_t op;
              uint8_t args_qty;
-    irasm_argument_t arg1;
-    irasm_argument_t arg2;
-    irasm_argument_t arg3;
-    irasm_argument_t arg4;
-    irasm_argument_t arg5;
-    irasm_argument_t arg6;
-    irasm_argument_t arg7;
-    irasm_argument_t arg8;
+             uint8_t numeric; // bit n is set if arg[n] is a number
+    irasm_argument_t arg[IRASM_MAXARGS];
 } asm_result_t;
 
+// test operand kind
+#define IRASM_ISNUM(a, n) (((a).numeric >> (n)) & 0x1)
+// resolve string operand
+#define IRASM_STR(a, n)   irasm_str((a).arg[n].str)
+
 extern fn_ir_elements_t *fn_ir_elements;
 extern long int fn_ir_elements_qty;
 
+// string table
+irasm_str_t irasm_strput(const char *str);
+const char* irasm_str(irasm_str_t idx);
+
 uint32_t gen_irasm(asm_result_t **irasm_result);
 void print_ir_fn_elements(void);
 void print_irasm(asm_result_t *irasm_result, uint32_t irasm_result_len);
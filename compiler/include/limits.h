@@ -24,14 +24,9 @@
 #define MAXLINEBUF   4096
 #define MAXTOKSIZE   256
 #define MAXNODECHILD 128
-#define MAXSYMENT    1024
 #define MAXREGNAME   8
 #define MAXFIELDLEN  64
 #define MAXDATASEC   128
 #define MAXTEXTSEC   4096
-#define MAXBBINST    4096
-#define MAXBBLINK    32
-#define MAXDAGNODES  1024
-#define MAXSETBITS   1024
 
 #endif /* _LIMITS_H_ */
@@ -23,33 +23,39 @@
 #include "symtab.h"
 #include "util.h"
 
-// array number counter
-#define NBITARR (MAXSETBITS / BITSIZE)
-
-// get syment_t *e representation
-#define REPR(e) (e->cate == TEMP_OBJ ? e->label : e->name)
-
-// bitset function
-void sset(bits_t bits[], syment_t *e);
-bool sget(bits_t bits[], syment_t *e);
-void sdup(bits_t des[], bits_t src[]);
-void sclr(bits_t *bits);
-bool ssame(bits_t a[], bits_t b[]);
-void sunion(bits_t *r, bits_t *a, bits_t *b);
-void ssub(bits_t *r, bits_t *a, bits_t *b);
-
-// helper
-inst_t* dupinst(op_t op, syment_t *d, syment_t *r, syment_t *s);
+// get opnd_t *o representation
+#define REPR(o) ((o)->kind == SYM_OPND ? atom_str((o)->sym->name) : opndlabel(o))
 
 // CFG: flow graph objects: Module, Function, BasicBlock
 typedef struct _module_struct mod_t;
 typedef struct _function_struct fun_t;
 typedef struct _basic_block_struct bb_t;
 
+// bitset function, sets of the LVA variables of fun
+void sset(fun_t *fun, bits_t bits[], opnd_t *o);
+bool sget(fun_t *fun, bits_t bits[], opnd_t *o);
+void sdel(fun_t *fun, bits_t bits[], opnd_t *o);
+void sdup(fun_t *fun, bits_t des[], bits_t src[]);
+void sclr(fun_t *fun, bits_t *bits);
+bool ssame(fun_t *fun, bits_t a[], bits_t b[]);
+void sunion(fun_t *fun, bits_t *r, bits_t *a, bits_t *b);
+void ssub(fun_t *fun, bits_t *r, bits_t *a, bits_t *b);
+// r = use union (out substract def), true if r changed
+bool stransfer(fun_t *fun, bits_t *r, bits_t *use, bits_t *out, bits_t *def);
+bits_t* snew(fun_t *fun);
+
+// helper
+inst_t* dupinst(op_t op, opnd_t d, opnd_t r, opnd_t s);
+// test if operand o is a variable
+bool isvar(opnd_t *o);
+// replace the instructions of bb by the qty instructions of v
+void bbcommit(bb_t *bb, inst_t **v, int qty);
+// grow arena array v of *cap elements of size bytes to hold one more
+void* optgrow(void *v, int qty, int *cap, size_t size);
+
 // DAG: graph, nodes
 typedef struct _dag_graph_struct dgraph_t;
 typedef struct _dag_node_struct dnode_t;
-typedef struct _dag_node_var_struct dnvar_t;
 
 // DFA: data flow analysis
 
@@ -61,15 +67,18 @@ struct _module_struct {
 struct _function_struct {
     // current scope
     symtab_t *scope;
+    opnd_t entry; // operand of FN_START/FN_END
 
     // basic block list
     bb_t *bhead; // prev of bhead is ENTRY
     bb_t *btail; // next of btail is EXIT
 
     // store variables in LVA
-    int total;		           // total variables
-    syment_t *vars[MAXSYMENT]; // symbol entry
-    int seqs[MAXSYMENT];	   // variable sequence
+    int total;		 // total variables
+    int varcap;      // vars capacity
+    opnd_t *vars;    // operand, by LVA index
+    int *varidx;     // map[id] LVA index + 1, 0 if not a variable, during LVA
+    int nwords;      // bits_t words in a variable set
 
     fun_t *next;
 };
@@ -78,36 +87,58 @@ struct _basic_block_struct {
     // basic information
     int bid;		          // block ID
     int total;		          // total number of instructions
-    inst_t *insts[MAXBBINST]; // instructions
+    inst_t *insts;            // instructions, a run of the IR vector until a pass rewrites them
     fun_t *fun;		          // which fun_t belongs to
     bb_t *next;		          // next BB
 
-    // links
-    bb_t *pred[MAXBBLINK]; // predecessors
-    bb_t *succ[MAXBBLINK]; // successors
+    // links, succ[0] is the fall through block
+    int predcnt;   // predecessors counter
+    int predcap;   // pred capacity
+    bb_t **pred;   // predecessors
+    int succcnt;   // successors counter
+    int succcap;   // succ capacity
+    bb_t **succ;   // successors
 
     // DAG optimization
-    dgraph_t *dag;		       // the DAG
-    int inst2cnt;		       // insts2[MAXBBINST] counter
-    inst_t *insts2[MAXBBINST]; // instructions after DAG optim
+    dgraph_t *dag;	  // the DAGs, one per run between barriers
+    int inst2cnt;	  // insts2 counter
+    int inst2cap;	  // insts2 capacity
+    inst_t **insts2;  // instructions after DAG optim
 
     // DFA: data flow analysis
-    bits_t in[NBITARR];  // in set
-    bits_t out[NBITARR]; // out set
+    bits_t *in;  // in set
+    bits_t *out; // out set
+    int po;      // postorder number + 1, 0 if not visited yet
+    bool queued; // on the solver worklist
 
     // LVA: live variable analysis
-    bits_t use[NBITARR]; // use set
-    bits_t def[NBITARR]; // def set
-
-    int inst3cnt;		       // insts3[MAXBBINST] counter
-    inst_t *insts3[MAXBBINST]; // instructions after DAG optim
+    bits_t *use; // use set
+    bits_t *def; // def set
+
+    int inst3cnt;	  // insts3 counter
+    int inst3cap;	  // insts3 capacity
+    inst_t **insts3;  // instructions after dead assign elimination
+
+    // block layout
+    int idx;          // position in the original order
+    bool reached;     // reached from the entry
+    bool placed;      // in a trace
+    int fallins;      // blocks falling into it, not placed yet
+    bb_t *fall;       // successor when not branching, NULL for the exit
+    bb_t *take;       // branch or jump target
 };
 
 struct _dag_graph_struct {
-    int gid;		              // graph ID
-    int nodecnt;		          // nodes counter
-    dnode_t *nodes[MAXDAGNODES];  // vertices
-    dnode_t *symmap[MAXDAGNODES]; // symbol map, mapping symbol to node
+    int gid;		    // graph ID
+    int nodecnt;	    // nodes counter
+    int nodecap;	    // nodes capacity
+    dnode_t **nodes;    // vertices
+    int symcnt;		    // syms counter
+    int symcap;		    // syms capacity
+    opnd_t *syms;       // operands mapped by this graph
+    int tabsize;        // operation node table size, a power of two
+    dnode_t **table;    // operation nodes by (op, lhs, rhs)
+    dgraph_t *next;     // next graph of the block
 };
 
 typedef enum dnode_cate_enum {
@@ -125,17 +156,7 @@ struct _dag_node_struct {
     dnode_t *rhs;      // right hand side
 
     // attributes for symbol node
-    syment_t *syment;  // symbol entry
-
-    // control parameters
-    dnvar_t *reflist; // reference to symbol entry
-    bool generated;	  // if current node is generated
-};
-
-// store referenecd symbol variables in DAG node
-struct _dag_node_var_struct {
-    syment_t *sym;
-    dnvar_t *next;
+    opnd_t opnd;       // operand holding the value of the node
 };
 
 // global module handler
@@ -153,8 +174,18 @@ void construct_flow_graph(void);
 void dag_optim(void);
 //   3. Live Variables Analysis
 void lva_optim(void);
-
-// optimize entry
+//   4. Block layout
+void layout_optim(void);
+//   5. Inlining, on the IR vector before the flow graph
+void inline_optim(void);
+//   6. Self tail calls to loops, on the IR vector before inlining
+void tail_optim(void);
+
+// optimize entry, runs the passes of the -O level and rebuilds the IR
+// vector from the optimized blocks
 void optim(void);
 
+// assembling and optimizer time of the generated IR
+void irbench(void);
+
 #endif /* _OPTIMIZE_H_ */
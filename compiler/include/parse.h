@@ -57,8 +57,8 @@ typedef struct _arg_list_node arg_list_node_t;
 extern int nidcnt;
 
 // Create New Node
-#define NEWNODE(s, v)     \
-		INITMEM(s, v);    \
+#define NEWNODE(s, v)             \
+		INITMEM(AST_ARENA, s, v); \
 		v->nid = ++nidcnt
 
 // use like:
@@ -70,12 +70,6 @@ extern int nidcnt;
 #define TOKANY5(a, b, c, d, e)     (currtok == (a) || currtok == (b) || currtok == (c) || currtok == (d) || currtok == (e))
 #define TOKANY6(a, b, c, d, e, f)  (currtok == (a) || currtok == (b) || currtok == (c) || currtok == (d) || currtok == (e) || currtok == (f))
 
-// ID read mode, for parse_ident()
-typedef enum _idreadmode_enum {
-    READCURR, //
-    READPREV  //
-} idreadmode_t;
-
 // syntax analysis, produce the syntax tree
 void parse(pgm_node_t **pgm);
 
@@ -18,13 +18,45 @@
 #ifndef _SCAN_H_
 #define _SCAN_H_
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "atom.h"
 #include "lexical.h"
 #include "limits.h"
 
-// token data, store current token string
-extern char tokbuf[MAXTOKSIZE + 1];
-// token location, line number
-extern int toklineno;
+// token span in source buffer
+typedef struct _tokspan_struct {
+    uint32_t offset; // first character
+    uint32_t length; // characters
+    uint32_t line;   // line number
+    uint32_t column; // column number
+} tokspan_t;
+
+// source buffer, the mapped input file
+extern const char *srcbuf;
+extern size_t srclen;
+
+// current token span
+extern tokspan_t tokspan;
+
+// token text, not NUL terminated
+#define TOKSTR(span)  (srcbuf + (span).offset)
+// first token character, NUL if empty
+#define TOKCHAR(span) ((span).length ? srcbuf[(span).offset] : '\0')
+
+// whole input as token stream, struct of arrays indexed by token number,
+// the last token is ENDFILE followed by one more ENDFILE for lookahead
+typedef struct _tokstream_struct {
+     uint8_t *kind;   // token_t
+    uint32_t *offset; // first character in srcbuf
+    uint32_t *length; // characters
+    uint32_t *line;   // line number
+      atom_t *atom;   // identifier or string text, NOATOM for others
+    uint32_t qty;     // tokens, up to the first ENDFILE included
+    uint32_t cap;     // allocated tokens
+} tokstream_t;
 
 // gettok states
 typedef enum _state_enum {
@@ -40,7 +72,82 @@ typedef enum _state_enum {
     DONE   // 0x09
 } state_t;
 
+// gettok character classes
+typedef enum _chclass_enum {
+    CC_OTHER, // 0x00 unprintable
+    CC_PRINT, // 0x01 printable without meaning
+    CC_SPACE, // 0x02 blank
+    CC_CNTRL, // 0x03 \t \n \v \f \r
+    CC_DIGIT, // 0x04
+    CC_ALPHA, // 0x05
+    CC_DQUO,  // 0x06 "
+    CC_SQUO,  // 0x07 '
+    CC_LBBR,  // 0x08 {
+    CC_RBBR,  // 0x09 }
+    CC_COLON, // 0x0a :
+    CC_GTT,   // 0x0b >
+    CC_LST,   // 0x0c <
+    CC_EQU,   // 0x0d =
+    CC_DOT,   // 0x0e .
+    CC_PLUS,  // 0x0f +
+    CC_MINUS, // 0x10 -
+    CC_STAR,  // 0x11 *
+    CC_OVER,  // 0x12 /
+    CC_COMMA, // 0x13 ,
+    CC_SEMI,  // 0x14 ;
+    CC_LPAR,  // 0x15 (
+    CC_RPAR,  // 0x16 )
+    CC_LBRA,  // 0x17 [
+    CC_RBRA,  // 0x18 ]
+    CC_EOF,   // 0x19 end of file
+    MAXCLASS  //
+} chclass_t;
+
+// runs of characters skipped in bulk
+typedef enum _skip_enum {
+    SKIP_SPACE,   // 0x00 whitespace
+    SKIP_COMMENT, // 0x01 comment body, up to }
+    SKIP_STRING,  // 0x02 string body, up to " or an unprintable character
+    SKIP_DIGIT,   // 0x03 digits
+    SKIP_ALNUM,   // 0x04 letters and digits
+    NOSKIP        // 0x05
+} skip_t;
+
+// instruction set used to skip runs
+typedef enum _skipisa_enum {
+    SKIP_SCALAR, // 0x00
+    SKIP_SSE2,   // 0x01
+    SKIP_AVX2    // 0x02
+} skipisa_t;
+
+// skip the run of kind in [p, end) and return its end, counting the
+// newlines crossed in lines and pointing lastnl to the last one
+typedef const char* (*skipfn_t)(skip_t kind, const char *p, const char *end, uint32_t *lines, const char **lastnl);
+
+// best instruction set of this CPU
+skipisa_t skip_best(void);
+// skip function for instruction set isa
+skipfn_t skip_select(skipisa_t isa);
+
+// map source file
+void scan_open(void);
+// unmap source file
+void scan_close(void);
+
 // get next token
 token_t gettok(void);
 
+// scan the whole input into ts
+void lexall(tokstream_t *ts);
+// free ts arrays
+void tokstream_free(tokstream_t *ts);
+
+// copy token text to d (MAXSTRLEN bytes), return its length
+int tokcopy(char *d, tokspan_t *span);
+// token value as number
+long int tokval(tokspan_t *span);
+
+// scan the whole input and report throughput
+void lexbench(void);
+
 #endif /* _SCAN_H_ */
@@ -73,7 +73,7 @@ enum VM_OPCODE {
     RETURN,            // | 0x2c |   -   |   -    |    -   | return from function without values
     RETURN_VALUE,      // | 0x2d |   -   |   -    |    -   | return from function with value
     CALL_FOREIGN,      // | 0x2e |   u8  |   u32  |  @u32  | call foreign function
-    LIB_FN,            // | 0x2f |   u8  |   u32  |    -   | call library function entry for lib_obj in stack with u8 function call type and u32 arguments
+    LIB_FN,            // | 0x2f |   u8  |   u32  |    -   | call library function u32 with u8 arguments popped from the stack
     GET_LOCAL,         // | 0x30 |  u32  |   -    |    -   | get local variable
     GET_LOCAL_FF,      // | 0x31 |   u8  |   -    |    -   | get local variable if the local index >= 0 and <= 0xff
     SET_LOCAL,         // | 0x32 |  u32  |   -    |    -   | set local variable
@@ -18,12 +18,16 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
+#include "atom.h"
 #include "common.h"
 #include "global.h"
 #include "limits.h"
 #include "parse.h"
 
-#define MAXBUCKETS 16
+// initial name index slots, a power of two
+#define MINSLOTS 16
+// labels returned by mklabel() live at once
+#define LABELRING 8
 
 typedef struct _sym_param_struct param_t;
 typedef struct _sym_entry_struct syment_t;
@@ -66,27 +70,39 @@ struct _sym_param_struct {
 
 struct _sym_entry_struct {
     int sid;               //
-    char name[MAXSTRLEN];  // identifier name
-    cate_t cate;           //
-    type_t type;           //
-    long int initval;      // const value, initval value
-    int arrlen;            //
-    char str[MAXSTRLEN];   //
-    param_t *phead;        //
-    symtab_t *scope;       //
-    char label[MAXSTRLEN]; // label for assemble codes
+    atom_t name;           // identifier name
+    cate_t cate : 8;       //
+    type_t type : 8;       //
     int off;               // offset, for local variable stack mapping
+    int arrlen;            //
     int lineno;            // referred line number
+    long int initval;      // const value, initval value
+    symtab_t *scope;       //
     symtab_t *stab;        // which symbol table
+    param_t *phead;        //
     syment_t *next;
 };
 
+// temporary or string constant of a scope, these are IR operands and not
+// symbols, the scope only keeps them for the frame layout and listings
+typedef struct _sym_temp_struct {
+    int id;      // operand id, drawn from the sid sequence
+    type_t type; //
+    atom_t text; // origin for temporaries, the constant for strings
+} tmpent_t;
+
+// name index slot, empty if e is NULL
+typedef struct _sym_slot_struct {
+    uint32_t hash; // hash of e->name
+    syment_t *e;   //
+} symslot_t;
+
 struct _sym_table_struct {
     int tid; // symbol table ID
 
     // for function scope management
     int depth;		        // symbol table nested depth
-    char nspace[MAXSTRLEN]; // namespace
+    atom_t nspace;	        // namespace
     syment_t *funcsym;	    // current scope function/procedure symbol
     symtab_t *inner;	    // inner scope
     symtab_t *outer;	    // outer scope
@@ -101,33 +117,54 @@ struct _sym_table_struct {
     int varoff; // variable offset in total
     int tmpoff; // temporary variable offset in total
 
-    // entries buckets
-    syment_t buckets[MAXBUCKETS];
+    // entries in declaration order
+    syment_t *ehead;
+    syment_t *etail;
+
+    // name index, open addressing
+    symslot_t *slots;  //
+    uint32_t slotqty;  // slots, a power of two
+    uint32_t named;    // indexed names
+
+    // temporaries (tmpoff of them) and string constants
+    tmpent_t *temps;   //
+    int tmpcap;        //
+    tmpent_t *strs;    //
+    int strqty;        //
+    int strcap;        //
 };
 
 // Constructor
-#define NEWPARAM(v) INITMEM(param_t, v)
-#define NEWENTRY(v) INITMEM(syment_t, v)
-#define NEWSTAB(v)  INITMEM(symtab_t, v)
+#define NEWPARAM(v) INITMEM(SYMTAB_ARENA, param_t, v)
+#define NEWENTRY(v) INITMEM(SYMTAB_ARENA, syment_t, v)
+#define NEWSTAB(v)  INITMEM(SYMTAB_ARENA, symtab_t, v)
 
-// store all symbols
-extern syment_t *syments[MAXSYMENT]; // map[sid]*syment_t
-extern int sidcnt;		             // sid counter
+// sid counter, sids are 1..sidcnt
+extern int sidcnt;
 
 // scope management
-symtab_t* scope_entry(char *nspace);
+symtab_t* scope_entry(atom_t nspace);
 symtab_t* scope_exit(void);
 symtab_t* scope_top(void);
 // symbol operator
 void symadd(syment_t *entry);
 void symadd2(symtab_t *stab, syment_t *entry);
 // symget only search current scope, while symfind search all.
-syment_t* symget(char *name);
-syment_t* symget2(symtab_t *stab, char *name);
-syment_t* symfind(char *name);
+syment_t* symget(atom_t name);
+syment_t* symget2(symtab_t *stab, atom_t name);
+syment_t* symfind(atom_t name);
      void stabdump(void);
 syment_t* syminit(ident_node_t *idp);
-syment_t* syminit2(symtab_t *stab, ident_node_t *idp, char *key);
-syment_t* symalloc(symtab_t *stab, char *name, cate_t cate, type_t type);
+syment_t* syminit2(symtab_t *stab, ident_node_t *idp, atom_t key);
+// add a temporary or a string constant to stab, return its id
+int symtemp(symtab_t *stab, char *name, type_t type);
+int symstring(symtab_t *stab, atom_t str);
+// label for assemble codes, derived from cate and id. The buffer is
+// reused after LABELRING calls.
+const char* mklabel(cate_t cate, int id);
+const char* symlabel(syment_t *e);
+
+// name index throughput with qty symbols in one scope
+void symbench(int qty);
 
 #endif /* _SYMTAB_H_ */
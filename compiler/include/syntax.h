@@ -217,8 +217,8 @@ typedef enum _write_enum {
 struct _write_stmt_node {
     int nid;
     write_t type;
-    // string pointer
-    char sp[MAXSTRLEN];
+    // string constant
+    atom_t sp;
     expr_node_t *ep;
     symtab_t *stab;
 };
@@ -323,7 +323,7 @@ typedef enum _ident_enum {
 struct _ident_node {
     int nid;
     idekind_t kind;
-    char name[MAXSTRLEN];
+    atom_t name;
     bool sign;
     long int value;
     int length;
@@ -18,6 +18,7 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -37,14 +38,15 @@ void chgsuf(char *str, char *to, char *from);
 char* itoa(int num);
 bool chkcmd(char *cmd);
 
-// bitset constants
+// bitset: words of 64 bits, the caller keeps the number of words n
+//
 // bit shift
-#define BITSHIFT 5
+#define BITSHIFT 6
 // elements of bit shift, which is 2^BITSHIFT
 #define BITSIZE (1 << BITSHIFT)
 
 // unsigned 64 bit int
-typedef unsigned int bits_t;
+typedef uint64_t bits_t;
 typedef char bin_t[BITSIZE + 1];
 
 //
@@ -53,14 +55,28 @@ typedef char bin_t[BITSIZE + 1];
 //        |---------||----|
 //             |       |
 //             |        `- offset in the bit (LSB BITSHIFT bits in index)
-//             `---------- position in array (HSB (BITSIZE-BITSHIFT) bits in index)
+//             `---------- position in array (HSB bits in index)
 //
 // offset of index(i)
-#define OFF(i)  (((bits_t)i) & (~((~0) << BITSHIFT)))
+#define OFF(i)  (((unsigned int) (i)) & (BITSIZE - 1))
 // position of index(i)
-#define POS(i)  ((((bits_t)i) & ((~0) << BITSHIFT)) >> BITSHIFT)
+#define POS(i)  (((unsigned int) (i)) >> BITSHIFT)
 // mask on element
-#define MASK(i) (1L << OFF(i))
+#define MASK(i) (((bits_t) 1) << OFF(i))
+// words to hold n bits
+#define BWORDS(n) (((n) + BITSIZE - 1) / BITSIZE)
+
+// instruction set of the bitset kernels
+typedef enum _bitsisa_enum {
+    BITS_SCALAR, // 0x00
+    BITS_SSE2,   // 0x01
+    BITS_AVX2    // 0x02
+} bitsisa_t;
+
+// best instruction set of this CPU
+bitsisa_t bits_best(void);
+// run the bitset kernels for instruction set isa, scalar until selected
+void bits_select(bitsisa_t isa);
 
 void bconv(bin_t str, bits_t b);
 void bset(bits_t bits[], int i);
@@ -72,5 +88,16 @@ bool bsame(bits_t a[], bits_t b[], int n);
 void bdup(bits_t des[], bits_t src[], int n);
 void bunion(bits_t r[], bits_t a[], bits_t b[], int n);
 void bsub(bits_t r[], bits_t a[], bits_t b[], int n);
+// r = use union (out substract def), true if r changed
+bool btransfer(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n);
+// number of set bits
+int bcount(bits_t bits[], int n);
+// first set bit from i on, -1 if none. Iterate with
+//   for (i = bnext(bits, n, 0); i >= 0; i = bnext(bits, n, i + 1))
+int bnext(bits_t bits[], int n, int i);
+
+// check every kernel against the scalar one on random sets and time them,
+// the number of mismatches
+int bitsbench(void);
 
 #endif /* _UTIL_H_ */
@@ -40,6 +40,12 @@ char PL0E_TARGET[MAXSTRLEN] = "a.out";
 bool PL0E_OPT_QUIET = false;
 bool PL0E_OPT_VERBOSE = false;
 bool PL0E_OPT_SET_TARGET_NAME = false;
+bool PL0E_OPT_LEX_BENCH = false;
+bool PL0E_OPT_SYMTAB_BENCH = false;
+bool PL0E_OPT_IR_BENCH = false;
+bool PL0E_OPT_BITS_BENCH = false;
+int PL0E_OPT_LEVEL = 0;
+int PL0E_OPT_INLINE_LIMIT = -1;
 
 // debug
 bool echo = false;
@@ -67,6 +73,30 @@ void pl0c_read_args(int argc, char *argv[]) {
             silent = false;
             continue;
         }
+        if (!strcmp("-lex-bench", argv[i])) {
+            PL0E_OPT_LEX_BENCH = true;
+            continue;
+        }
+        if (!strcmp("-symtab-bench", argv[i])) {
+            PL0E_OPT_SYMTAB_BENCH = true;
+            continue;
+        }
+        if (!strcmp("-ir-bench", argv[i])) {
+            PL0E_OPT_IR_BENCH = true;
+            continue;
+        }
+        if (!strcmp("-bits-bench", argv[i])) {
+            PL0E_OPT_BITS_BENCH = true;
+            continue;
+        }
+        if (!strcmp("-O0", argv[i]) || !strcmp("-O1", argv[i]) || !strcmp("-O2", argv[i])) {
+            PL0E_OPT_LEVEL = argv[i][2] - '0';
+            continue;
+        }
+        if (!strncmp("-finline-limit=", argv[i], 15)) {
+            PL0E_OPT_INLINE_LIMIT = atoi(argv[i] + 15);
+            continue;
+        }
         if (!strcmp("-o", argv[i])) {
             PL0E_OPT_SET_TARGET_NAME = true;
             i++;
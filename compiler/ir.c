@@ -15,12 +15,12 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "ir.h"
 #include "symtab.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 // OPCODE Table
 char *opcode[32] = {
         [0] = "ADD",
@@ -57,48 +57,114 @@ char *opcode[32] = {
 };
 
 // instructions
-inst_t *xhead;
-inst_t *xtail;
+inst_t *insts = NULL;
+int instqty = 0;
+static int instcap = 0;
 
 // instruction count
 int xidcnt = 0;
 
 static inst_t* emit(op_t op) {
-    inst_t *t;
-    NEWINST(t);
+    // amortized growth
+    if (instqty == instcap) {
+        instcap = instcap ? instcap * 2 : 256;
+        insts = realloc(insts, instcap * sizeof(inst_t));
+        if (insts == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+
+    inst_t *t = &insts[instqty++];
+    memset(t, 0, sizeof(inst_t));
     t->xid = ++xidcnt;
     t->op = op;
 
-    if (xtail) {
-        t->prev = xtail;
-        xtail->next = t;
-        xtail = t;
-    } else {
-        t->prev = xtail;
-        xhead = xtail = t;
-    }
-
     dbg("emit xid=%d op=%d\n", t->xid, op);
     return t;
 }
 
-inst_t* emit1(op_t op, syment_t *d) {
+opnd_t symopnd(syment_t *e) {
+    return (opnd_t) { .kind = SYM_OPND, .type = e->type, .id = e->sid, .sym = e };
+}
+
+opnd_t immopnd(long int value, type_t type) {
+    return (opnd_t) { .kind = IMM_OPND, .type = type, .id = ++sidcnt, .imm = value };
+}
+
+opnd_t vregopnd(symtab_t *stab, char *name, type_t type) {
+    return (opnd_t) { .kind = VREG_OPND, .type = type, .id = symtemp(stab, name, type) };
+}
+
+opnd_t labelopnd(void) {
+    return (opnd_t) { .kind = LABEL_OPND, .type = VOID_TYPE, .id = ++sidcnt };
+}
+
+opnd_t stropnd(symtab_t *stab, atom_t str) {
+    return (opnd_t) { .kind = STR_OPND, .type = STRING_TYPE, .id = symstring(stab, str) };
+}
+
+cate_t opndcate(opnd_t *o) {
+    switch (o->kind) {
+        case SYM_OPND:
+            return o->sym->cate;
+        case IMM_OPND:
+            return NUMBER_OBJ;
+        case VREG_OPND:
+            return TEMP_OBJ;
+        case LABEL_OPND:
+            return LABEL_OBJ;
+        case STR_OPND:
+            return STRING_OBJ;
+        default:
+            return NOP_OBJ;
+    }
+}
+
+long int opndval(opnd_t *o) {
+    switch (o->kind) {
+        case SYM_OPND:
+            return o->sym->initval;
+        case IMM_OPND:
+            return o->imm;
+        default:
+            return 0;
+    }
+}
+
+const char* opndlabel(opnd_t *o) {
+    return mklabel(opndcate(o), o->id);
+}
+
+inst_t* emit1(op_t op, opnd_t d) {
     inst_t *x = emit(op);
     x->d = d;
     return x;
 }
 
-inst_t* emit2(op_t op, syment_t *d, syment_t *r) {
+inst_t* emit2(op_t op, opnd_t d, opnd_t r) {
     inst_t *x = emit(op);
     x->d = d;
     x->r = r;
     return x;
 }
 
-inst_t* emit3(op_t op, syment_t *d, syment_t *r, syment_t *s) {
+inst_t* emit3(op_t op, opnd_t d, opnd_t r, opnd_t s) {
     inst_t *x = emit(op);
     x->d = d;
     x->r = r;
     x->s = s;
     return x;
 }
+
+inst_t* ir_detach(void) {
+    inst_t *v = insts;
+    insts = NULL;
+    instqty = instcap = 0;
+    return v;
+}
+
+void ir_free(void) {
+    free(insts);
+    insts = NULL;
+    instqty = instcap = 0;
+}
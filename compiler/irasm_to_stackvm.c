@@ -18,22 +18,1415 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "arena.h"
 #include "ir.h"
+#include "global.h"
+#include "debug.h"
+#include "error.h"
 #include "stackvm_opcodes.h"
 #include "irassembler.h"
 #include "irasm_to_stackvm.h"
 
-static void correct_consecutive_operations(asm_result_t *irasm, uint32_t irasm_len, asm_result_t **stackvm_asm, uint32_t *stackvm_asm_len) {
-    uint32_t line;
+// symbol storage
+typedef enum _vmstore_enum {
+    LOCAL_STORE,  // frame local
+    GLOBAL_STORE, // global variable
+    MEM_STORE,    // element of the MEM array
+    FRAME_STORE   // element of the MEM frame of a recursive function
+} vmstore_t;
 
-    for (line = 0; line > irasm_len; line++) {
+typedef struct _vmsym_struct {
+    irasm_str_t label;
+       long int fn;        // owner function
+        uint8_t cate;      // symbol category
+       uint32_t length;    // array length
+           bool byref;     // holds an address
+           bool escape;    // referenced from another function
+           bool addressed; // address is taken
+      vmstore_t store;     //
+       uint32_t index;     // local, global, MEM index or frame offset
+       uint32_t argslot;   // incoming argument local, for arguments moved to MEM
+       uint32_t defs;      // instructions writing the symbol
+       uint32_t uses;      // instructions reading the symbol
+           bool stacked;   // temporary living on the operand stack, no slot
+           bool shared;    // temporary in a slot shared by live range
+       uint32_t slot;      // shared slot, after the other locals
+       uint32_t first;     // live range of a shared temporary, irasm lines
+       uint32_t last;      //
+} vmsym_t;
 
+typedef struct _vmfun_struct {
+    uint32_t reserve;   // locals reserved by CALL
+    uint32_t slots;     // shared temporary slots
+    uint32_t addr;      // entry pc
+        bool main;      // main program
+    uint32_t callees;   // calls[...] of the function, callees_qty of them
+    uint32_t callees_qty;
+        bool recursive; // can be called while it runs
+    uint32_t frame;     // MEM cells of an activation, recursive functions
+    uint32_t display;   // global holding the frame base of the last activation
+    uint32_t saved;     // local keeping the display of the former activation
+    uint32_t order;     // SCC search: visit order + 1, 0 not visited
+    uint32_t low;       //
+        bool onstack;   //
+} vmfun_t;
+
+// jump of a function, irasm lines
+typedef struct _vmedge_struct {
+    uint32_t from;      // jump
+    uint32_t to;        // label
+    irasm_str_t label;  //
+} vmedge_t;
+
+// irasm_str_t keyed hash map
+typedef struct _vmmap_struct {
+    uint32_t *keys; // key + 1, 0 is empty
+    uint32_t *vals;
+    uint32_t qty;
+    uint32_t used;
+} vmmap_t;
+
+static vmsym_t *syms;
+static uint32_t syms_qty;
+static vmfun_t *funs;
+static vmmap_t symmap;  // label => syms[...]
+static vmmap_t funmap;  // function label => funs[...]
+static vmmap_t labmap;  // label => pc
+static vmmap_t strmap;  // string label => strpool offset
+
+// call graph, callees of each function
+static uint32_t *calls;
+static uint32_t calls_qty;
+
+// string constants, appended after code
+static char *strpool;
+static uint32_t strpool_len;
+
+static uint32_t mem_qty;     // MEM array size
+static uint32_t mem_static;  // MEM cells below the frames
+static uint32_t mem_sp;      // global holding the MEM frame stack top, 0 if no frames
+static uint32_t overflow;    // pc of the MEM frame stack overflow halt
+static uint32_t globals_qty; // globals used
+static uint32_t vminsts;     // VM instructions emitted
+
+// program image
+static uint8_t *image;
+static uint32_t image_cap;
+static uint32_t pc;
+static bool emitting; // false on the first (sizing) pass
+
+//////////////////////// maps //////////////////////////
+
+static void map_put(vmmap_t *m, uint32_t key, uint32_t val) {
+    if ((m->used + 1) * 2 > m->qty) {
+        vmmap_t n = { 0 };
+        n.qty = m->qty ? m->qty * 2 : 64;
+        n.keys = calloc(n.qty, sizeof(uint32_t));
+        n.vals = calloc(n.qty, sizeof(uint32_t));
+        if (n.keys == NULL || n.vals == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+        for (uint32_t i = 0; i < m->qty; i++) {
+            if (m->keys[i]) {
+                map_put(&n, m->keys[i] - 1, m->vals[i]);
+            }
+        }
+        free(m->keys);
+        free(m->vals);
+        *m = n;
+    }
+
+    uint32_t i = (key * 2654435761u) & (m->qty - 1);
+    while (m->keys[i] && m->keys[i] != key + 1) {
+        i = (i + 1) & (m->qty - 1);
+    }
+    if (!m->keys[i]) {
+        m->keys[i] = key + 1;
+        ++m->used;
+    }
+    m->vals[i] = val;
+}
+
+static bool map_get(vmmap_t *m, uint32_t key, uint32_t *val) {
+    if (!m->qty) {
+        return false;
+    }
+
+    uint32_t i = (key * 2654435761u) & (m->qty - 1);
+    while (m->keys[i]) {
+        if (m->keys[i] == key + 1) {
+            *val = m->vals[i];
+            return true;
+        }
+        i = (i + 1) & (m->qty - 1);
+    }
+    return false;
+}
+
+static void map_free(vmmap_t *m) {
+    free(m->keys);
+    free(m->vals);
+    memset(m, 0, sizeof(vmmap_t));
+}
+
+/////////////////////// emitter ////////////////////////
+
+static void put8(uint8_t v) {
+    if (emitting) {
+        if (pc >= image_cap) {
+            image_cap = image_cap ? image_cap * 2 : 4096;
+            image = realloc(image, image_cap);
+            if (image == NULL) {
+                panic("OUT_OF_MEMORY");
+            }
+        }
+        image[pc] = v;
+    }
+    ++pc;
+}
+
+static void put16(uint16_t v) {
+    put8(v & 0xff);
+    put8(v >> 8);
+}
+
+static void put32(uint32_t v) {
+    put16(v & 0xffff);
+    put16(v >> 16);
+}
+
+static void op0(uint8_t op) {
+    ++vminsts;
+    put8(op);
+}
+
+static void op8(uint8_t op, uint8_t v) {
+    op0(op);
+    put8(v);
+}
+
+static void op16(uint8_t op, uint16_t v) {
+    op0(op);
+    put16(v);
+}
+
+static void op32(uint8_t op, uint32_t v) {
+    op0(op);
+    put32(v);
+}
+
+// jump to label, resolved on the second pass
+static void opjump(uint8_t op, irasm_str_t label) {
+    uint32_t addr = 0;
+    if (emitting && !map_get(&labmap, label, &addr)) {
+        panic("UNDEFINED_LABEL");
+    }
+    op32(op, addr);
+}
+
+// library call, u8 count of arguments popped, u32 library function
+static void oplib(uint8_t nargs, uint32_t lib) {
+    op8(LIB_FN, nargs);
+    put32(lib);
+}
+
+static void push_imm(uint8_t type, int32_t value) {
+    if (type == CHAR_TYPE) {
+        op8(PUSH_CHAR, (uint8_t) value);
+    } else if (value == 0) {
+        op0(PUSH_0);
+    } else if (value == 1) {
+        op0(PUSH_1);
+    } else if (type == UINT_TYPE) {
+        op32(PUSH_UINT, (uint32_t) value);
+    } else {
+        op32(PUSH_INT, (uint32_t) value);
+    }
+}
+
+static void get_local(uint32_t index) {
+    if (index <= 0xff) {
+        op8(GET_LOCAL_FF, index);
+    } else {
+        op32(GET_LOCAL, index);
+    }
+}
+
+static void set_local(uint32_t index) {
+    if (index <= 0xff) {
+        op8(SET_LOCAL_FF, index);
+    } else {
+        op32(SET_LOCAL, index);
+    }
+}
+
+// push MEM[top]
+static void mem_deref(void) {
+    op32(SET_GLOBAL, STACKVM_INDIRECT);
+    op32(GET_GLOBAL, STACKVM_MEMREF);
+    op16(GET_ARRAY_VALUE, STACKVM_INDIRECT16);
+}
+
+// MEM[top] = second
+static void mem_assign(void) {
+    op32(SET_GLOBAL, STACKVM_INDIRECT);
+    op32(GET_GLOBAL, STACKVM_MEMREF);
+    op16(SET_ARRAY_VALUE, STACKVM_INDIRECT16);
+}
+
+// push MEM address of a frame symbol: frame base + offset
+static void push_frame(vmsym_t *sym) {
+    op32(GET_GLOBAL, funs[sym->fn].display);
+    if (sym->index) {
+        push_imm(INT_TYPE, sym->index);
+        op0(ADD);
+    }
+}
+
+// push symbol slot content (the address for references)
+static void get_slot(vmsym_t *sym) {
+    switch (sym->store) {
+        case LOCAL_STORE:
+            get_local(sym->index);
+            break;
+        case GLOBAL_STORE:
+            op32(GET_GLOBAL, sym->index);
+            break;
+        case MEM_STORE:
+            op32(GET_GLOBAL, STACKVM_MEMREF);
+            op16(GET_ARRAY_VALUE, sym->index);
+            break;
+        case FRAME_STORE:
+            push_frame(sym);
+            mem_deref();
+            break;
+    }
+}
+
+// pop into symbol slot
+static void set_slot(vmsym_t *sym) {
+    switch (sym->store) {
+        case LOCAL_STORE:
+            set_local(sym->index);
+            break;
+        case GLOBAL_STORE:
+            op32(SET_GLOBAL, sym->index);
+            break;
+        case MEM_STORE:
+            op32(GET_GLOBAL, STACKVM_MEMREF);
+            op16(SET_ARRAY_VALUE, sym->index);
+            break;
+        case FRAME_STORE:
+            push_frame(sym);
+            mem_assign();
+            break;
+    }
+}
+
+static void load(vmsym_t *sym) {
+    get_slot(sym);
+    if (sym->byref) {
+        mem_deref();
+    }
+}
+
+static void store(vmsym_t *sym) {
+    if (sym->byref) {
+        get_slot(sym);
+        mem_assign();
+    } else {
+        set_slot(sym);
+    }
+}
+
+static vmsym_t* lookup(irasm_str_t label) {
+    uint32_t n;
+    return map_get(&symmap, label, &n) ? &syms[n] : NULL;
+}
+
+// push operand n, immediates take type and value from args tpos and tpos + 1.
+// A stacked temporary is on top already
+static void push_operand(asm_result_t *a, int n, int tpos) {
+    vmsym_t *sym = lookup(a->arg[n].str);
+    if (sym) {
+        if (!sym->stacked) {
+            load(sym);
+        }
+    } else {
+        push_imm(a->arg[tpos].number, a->arg[tpos + 1].number);
+    }
+}
+
+// pop into operand n, a stacked temporary stays on top
+static void store_operand(asm_result_t *a, int n) {
+    vmsym_t *sym = lookup(a->arg[n].str);
+    nevernil(sym);
+    if (!sym->stacked) {
+        store(sym);
+    }
+}
+
+// push MEM address of array element: base + index
+static void push_element(asm_result_t *a, int arr, int idx, int tpos) {
+    vmsym_t *sym = lookup(a->arg[arr].str);
+    nevernil(sym);
+    push_operand(a, idx, tpos);
+    switch (sym->store) {
+        case MEM_STORE:
+            if (sym->index) {
+                push_imm(INT_TYPE, sym->index);
+                op0(ADD);
+            }
+            break;
+        case FRAME_STORE:
+            push_frame(sym);
+            op0(ADD);
+            break;
+        default:
+            unlikely();
+    }
+}
+
+////////////////////// symbols /////////////////////////
+
+static void add_sym(irasm_str_t label, long int fn, uint8_t cate, uint32_t length) {
+    if (!(syms_qty & (syms_qty - 1))) {
+        syms = realloc(syms, (syms_qty ? syms_qty * 2 : 1) * sizeof(vmsym_t));
+        if (syms == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+    vmsym_t *sym = &syms[syms_qty];
+    memset(sym, 0, sizeof(vmsym_t));
+    sym->label = label;
+    sym->fn = fn;
+    sym->cate = cate;
+    sym->length = length;
+    sym->byref = cate == BY_REFERENCE_OBJ;
+    map_put(&symmap, label, syms_qty++);
+}
+
+static void collect_symbols(void) {
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        fn_ir_elements_t *f = &fn_ir_elements[fn];
+        funs[fn].main = !strcmp(irasm_str(f->name), MAINFUNC);
+        map_put(&funmap, f->label, fn);
+
+        for (long int i = 0; i < f->args_qty; i++) {
+            add_sym(f->args[i].label, fn, f->args[i].category, 1);
+            syms[syms_qty - 1].argslot = i;
+        }
+        // return value
+        if (f->category == FUNCTION_OBJ && !funs[fn].main) {
+            add_sym(f->label, fn, FUNCTION_OBJ, 1);
+        }
+        for (long int i = 0; i < f->locales_qty; i++) {
+            add_sym(f->locales[i].label, fn, f->locales[i].category, f->locales[i].category == ARRAY_OBJ ? f->locales[i].length : 1);
+        }
+        for (long int i = 0; i < f->temps_qty; i++) {
+            add_sym(f->temps[i].label, fn, f->temps[i].category, 1);
+        }
+        for (long int i = 0; i < f->strings_qty; i++) {
+            const char *str = irasm_str(f->strings[i].value);
+            uint32_t len = strlen(str) + 1;
+            strpool = realloc(strpool, strpool_len + len);
+            if (strpool == NULL) {
+                panic("OUT_OF_MEMORY");
+            }
+            memcpy(strpool + strpool_len, str, len);
+            map_put(&strmap, f->strings[i].label, strpool_len);
+            strpool_len += len;
+        }
+    }
+}
+
+// symbol operands of each instruction
+static int sym_operands(asm_result_t *a, int ops[3]) {
+    switch (a->op) {
+        case ADD_OP:
+        case SUB_OP:
+        case MUL_OP:
+        case DIV_OP:
+        case LOAD_ARRAY_OP:
+        case STORE_ARRAY_OP:
+            ops[0] = 0;
+            ops[1] = 1;
+            ops[2] = 2;
+            return 3;
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+            ops[0] = 1;
+            ops[1] = 2;
+            return 2;
+        case NEG_OP:
+        case STORE_VAR_OP:
+            ops[0] = 0;
+            ops[1] = 1;
+            return 2;
+        case PUSH_ADDR_OP:
+            ops[0] = 0;
+            ops[1] = 1;
+            return a->args_qty > 1 ? 2 : 1;
+        case INC_OP:
+        case DEC_OP:
+        case PUSH_VAL_OP:
+        case READ_INT_OP:
+        case READ_UINT_OP:
+        case READ_CHAR_OP:
+        case WRITE_INT_OP:
+        case WRITE_UINT_OP:
+        case WRITE_CHAR_OP:
+            ops[0] = 0;
+            return 1;
+        case CALL_OP:
+            ops[0] = 1;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void add_call(asm_result_t *a) {
+    uint32_t callee = 0;
+    if (!map_get(&funmap, a->arg[2].str, &callee)) {
+        panic("UNDEFINED_FUNCTION");
+    }
+    if (!(calls_qty & (calls_qty - 1))) {
+        calls = realloc(calls, (calls_qty ? calls_qty * 2 : 1) * sizeof(uint32_t));
+        if (calls == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+    calls[calls_qty++] = callee;
+}
+
+// find symbols referenced from other functions or with address taken, and
+// the calls of every function
+static void escape_analysis(asm_result_t *irasm, uint32_t irasm_len) {
+    long int fn = -1;
+    int ops[3];
+
+    for (uint32_t line = 0; line < irasm_len; ++line) {
+        asm_result_t *a = &irasm[line];
+        if (a->op == FN_START_OP) {
+            ++fn;
+            funs[fn].callees = calls_qty;
+            continue;
+        }
+        if (a->op == CALL_OP) {
+            add_call(a);
+            funs[fn].callees_qty++;
+        }
+
+        int qty = sym_operands(a, ops);
+        for (int n = 0; n < qty; n++) {
+            vmsym_t *sym = lookup(a->arg[ops[n]].str);
+            if (sym && sym->fn != fn && !funs[sym->fn].main) {
+                sym->escape = true;
+            }
+        }
+        if (a->op == PUSH_ADDR_OP) {
+            lookup(a->arg[0].str)->addressed = true;
+        }
+    }
+}
+
+// strongly connected components of the call graph (Tarjan). A function in
+// a component of more than one, or calling itself, is recursive
+static void scc(uint32_t fn, uint32_t *stack, uint32_t *top, uint32_t *visits) {
+    vmfun_t *f = &funs[fn];
+    f->order = f->low = ++*visits;
+    f->onstack = true;
+    stack[(*top)++] = fn;
+
+    for (uint32_t n = f->callees; n < f->callees + f->callees_qty; n++) {
+        vmfun_t *g = &funs[calls[n]];
+        if (calls[n] == fn) {
+            f->recursive = true;
+        }
+        if (!g->order) {
+            scc(calls[n], stack, top, visits);
+            f->low = g->low < f->low ? g->low : f->low;
+        } else if (g->onstack) {
+            f->low = g->order < f->low ? g->order : f->low;
+        }
+    }
+
+    if (f->low != f->order) {
+        return;
+    }
+    uint32_t beg = *top;
+    do {
+        funs[stack[--beg]].onstack = false;
+    } while (stack[beg] != fn);
+    for (uint32_t n = beg; *top - beg > 1 && n < *top; n++) {
+        funs[stack[n]].recursive = true;
+    }
+    *top = beg;
+}
+
+static void find_recursion(void) {
+    uint32_t *stack = malloc((fn_ir_elements_qty + 1) * sizeof(uint32_t));
+    uint32_t top = 0, visits = 0;
+    if (stack == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        if (!funs[fn].order) {
+            scc(fn, stack, &top, &visits);
+        }
+    }
+    free(stack);
+}
+
+// static MEM cells, or the frame of each activation of a recursive function
+static void mem_alloc(vmsym_t *sym) {
+    vmfun_t *fun = &funs[sym->fn];
+    if (fun->recursive) {
+        sym->store = FRAME_STORE;
+        sym->index = fun->frame;
+        fun->frame += sym->length;
+    } else {
+        sym->store = MEM_STORE;
+        sym->index = mem_qty;
+        mem_qty += sym->length;
+    }
+}
+
+static bool is_arg(vmsym_t *sym) {
+    return sym->cate == BY_VALUE_OBJ || sym->cate == BY_REFERENCE_OBJ;
+}
+
+// assign storage to every symbol
+static void layout(void) {
+    globals_qty = STACKVM_MEMREF + 1;
+
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        vmsym_t *sym = &syms[n];
+        vmfun_t *fun = &funs[sym->fn];
+
+        // temporaries on the operand stack, or left unused by the optimizer
+        if (sym->cate == TEMP_OBJ && (sym->stacked || (PL0E_OPT_LEVEL && !sym->defs && !sym->uses))) {
+            continue;
+        }
+
+        // placed after the other locals, below
+        if (sym->shared) {
+            sym->store = fun->main ? GLOBAL_STORE : LOCAL_STORE;
+            continue;
+        }
+
+        if (sym->cate == ARRAY_OBJ || sym->addressed || (sym->escape && !fun->main)) {
+            mem_alloc(sym);
+        } else if (fun->main) {
+            sym->store = GLOBAL_STORE;
+            sym->index = globals_qty++;
+        } else if (!is_arg(sym)) {
+            sym->store = LOCAL_STORE;
+            sym->index = fun->reserve++;
+        }
     }
 
+    // the display of the caller's activation is kept in a local
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        if (funs[fn].frame) {
+            funs[fn].saved = funs[fn].reserve++;
+        }
+    }
+
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        vmsym_t *sym = &syms[n];
+        if (sym->shared) {
+            sym->index = sym->slot + (funs[sym->fn].main ? globals_qty : funs[sym->fn].reserve);
+        }
+    }
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        if (funs[fn].main) {
+            globals_qty += funs[fn].slots;
+        } else {
+            funs[fn].reserve += funs[fn].slots;
+        }
+    }
+
+    // frames are stacked in MEM above the static cells
+    uint32_t frame_max = 0;
+    mem_static = mem_qty;
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        if (funs[fn].frame) {
+            funs[fn].display = globals_qty++;
+            frame_max = funs[fn].frame > frame_max ? funs[fn].frame : frame_max;
+        }
+    }
+    if (frame_max && mem_static < STACKVM_INDIRECT16) {
+        mem_sp = globals_qty++;
+        mem_qty += STACKVM_INDIRECT16 - 1 - mem_static < STACKVM_MEMSTACK ? STACKVM_INDIRECT16 - 1 - mem_static : STACKVM_MEMSTACK;
+        if (mem_qty - mem_static < frame_max) {
+            rescue(TOOBIG, "a recursive frame needs %u memory cells, %u are left.", frame_max, mem_qty - mem_static);
+        }
+    }
+
+    // arguments follow the reserved locals, first argument (pushed last) first
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        vmsym_t *sym = &syms[n];
+        if (!is_arg(sym)) {
+            continue;
+        }
+        sym->argslot += funs[sym->fn].reserve;
+        if (sym->store != MEM_STORE && sym->store != FRAME_STORE) {
+            sym->store = LOCAL_STORE;
+            sym->index = sym->argslot;
+        }
+    }
+
+    if (mem_static >= STACKVM_INDIRECT16) {
+        rescue(TOOBIG, "program needs %u memory cells, limit is %u.", mem_static, STACKVM_INDIRECT16 - 1);
+    }
+
+    for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+        if (funs[fn].reserve > 0xff) {
+            rescue(TOOBIG, "%s() needs %u locals, CALL can reserve 255.", irasm_str(fn_ir_elements[fn].name), funs[fn].reserve);
+        }
+    }
+}
+
+/////////////////////// stackify ///////////////////////
+
+// An expression leaves its value on the operand stack and the IR stores it
+// in a temporary, which the instruction reading it pushes back. When the
+// temporary is read once, in the same block, and the values pushed and
+// popped in between leave it on top in the order its reader pushes its
+// operands, both the store and the push are dropped: the expression tree
+// runs in post order on the stack, a*b+c is push, push, MUL, push, ADD.
+
+#define LITERAL_ARG -1          // operand pushed as a constant
+#define OPAQUE_VALUE UINT32_MAX // argument value left on the stack
+
+// operands the lowering of a pushes, in order, as arg indexes. *def is the
+// arg stored last, -1 if none
+static int stack_uses(asm_result_t *a, int uses[2], int *def) {
+    *def = -1;
+    switch (a->op) {
+        case ADD_OP:
+        case SUB_OP:
+        case MUL_OP:
+        case DIV_OP:
+            uses[0] = 1;
+            uses[1] = 2;
+            *def = 0;
+            return 2;
+        case NEG_OP:
+            uses[0] = LITERAL_ARG;
+            uses[1] = 1;
+            *def = 0;
+            return 2;
+        case INC_OP:
+        case DEC_OP:
+            uses[0] = 0;
+            *def = 0;
+            return 1;
+        case LOAD_ARRAY_OP:
+            uses[0] = 2;
+            *def = 0;
+            return 1;
+        case STORE_VAR_OP:
+            uses[0] = 1;
+            *def = 0;
+            return 1;
+        case STORE_ARRAY_OP:
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+            uses[0] = 1;
+            uses[1] = 2;
+            return 2;
+        case PUSH_VAL_OP:
+        case WRITE_INT_OP:
+        case WRITE_UINT_OP:
+        case WRITE_CHAR_OP:
+            uses[0] = 0;
+            return 1;
+        case PUSH_ADDR_OP:
+            uses[0] = 1;
+            return a->args_qty > 1 ? 1 : 0;
+        case CALL_OP:
+            *def = 1;
+            return 0;
+        case READ_INT_OP:
+        case READ_UINT_OP:
+        case READ_CHAR_OP:
+            *def = 0;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static vmsym_t* stack_sym(asm_result_t *a, int arg) {
+    return arg == LITERAL_ARG ? NULL : lookup(a->arg[arg].str);
+}
+
+// run the block [beg, end) on a model of the operand stack. A stacked
+// temporary out of place is demoted to a slot and false is returned, the
+// caller runs the block again
+static bool stack_block(asm_result_t *irasm, uint32_t beg, uint32_t end, uint32_t *stack) {
+    uint32_t top = 0;
+    int uses[2], def;
+
+    for (uint32_t line = beg; line < end; ++line) {
+        asm_result_t *a = &irasm[line];
+        int qty = stack_uses(a, uses, &def);
+
+        // the stacked operands lead and are the top of the stack, in order
+        int lead = 0;
+        while (lead < qty && stack_sym(a, uses[lead]) && stack_sym(a, uses[lead])->stacked) {
+            ++lead;
+        }
+        bool fit = (uint32_t) lead <= top;
+        for (int n = 0; fit && n < lead; n++) {
+            fit = stack[top - lead + n] == stack_sym(a, uses[n]) - syms;
+        }
+        for (int n = lead; fit && n < qty; n++) {
+            fit = !stack_sym(a, uses[n]) || !stack_sym(a, uses[n])->stacked;
+        }
+        if (!fit) {
+            for (int n = 0; n < qty; n++) {
+                if (stack_sym(a, uses[n])) {
+                    stack_sym(a, uses[n])->stacked = false;
+                }
+            }
+            return false;
+        }
+        top -= lead;
+
+        switch (a->op) {
+            case PUSH_VAL_OP:
+            case PUSH_ADDR_OP:
+                stack[top++] = OPAQUE_VALUE;
+                break;
+            case POP_OP:
+                // the call result has to leave the arguments' way
+                if (top && stack[top - 1] != OPAQUE_VALUE) {
+                    syms[stack[top - 1]].stacked = false;
+                    return false;
+                }
+                top -= top ? 1 : 0;
+                break;
+            default:
+                if (def >= 0 && stack_sym(a, def) && stack_sym(a, def)->stacked) {
+                    stack[top++] = stack_sym(a, def) - syms;
+                }
+        }
+    }
+
+    // nothing stacked crosses the block end
+    bool clean = true;
+    for (uint32_t n = 0; n < top; n++) {
+        if (stack[n] != OPAQUE_VALUE) {
+            syms[stack[n]].stacked = false;
+            clean = false;
+        }
+    }
+    return clean;
+}
+
+// count the reads and writes of every symbol and stack the temporaries that
+// fit
+static void stackify(asm_result_t *irasm, uint32_t irasm_len) {
+    int uses[2], def;
+
+    for (uint32_t line = 0; line < irasm_len; ++line) {
+        asm_result_t *a = &irasm[line];
+        int qty = stack_uses(a, uses, &def);
+        for (int n = 0; n < qty; n++) {
+            vmsym_t *sym = stack_sym(a, uses[n]);
+            if (sym) {
+                ++sym->uses;
+            }
+        }
+        if (def >= 0 && stack_sym(a, def)) {
+            ++stack_sym(a, def)->defs;
+        }
+    }
+
+    if (!PL0E_OPT_LEVEL) {
+        return;
+    }
+
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        vmsym_t *sym = &syms[n];
+        sym->stacked = sym->cate == TEMP_OBJ && !sym->escape && !sym->addressed && sym->defs == 1 && sym->uses == 1;
+    }
+
+    // blocks end at labels, jumps and function bounds
+    uint32_t *stack = malloc((irasm_len + 1) * sizeof(uint32_t));
+    if (stack == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+    uint32_t beg = 0, end;
+    for (uint32_t line = 0; line < irasm_len; ++line) {
+        switch (irasm[line].op) {
+            case LABEL_OP:
+            case FN_START_OP:
+            case FN_END_OP:
+                // opens the next block
+                end = line;
+                break;
+            case BRANCH_EQU_OP:
+            case BRANCH_NEQ_OP:
+            case BRANCH_GTT_OP:
+            case BRANCH_GEQ_OP:
+            case BRANCH_LST_OP:
+            case BRANCH_LEQ_OP:
+            case JUMP_OP:
+                // the jump closes its block
+                end = line + 1;
+                break;
+            default:
+                continue;
+        }
+        while (!stack_block(irasm, beg, end, stack))
+            ;
+        beg = end;
+    }
+    while (!stack_block(irasm, beg, irasm_len, stack))
+        ;
+    free(stack);
+}
+
+/////////////////////// slots ////////////////////////
+
+// Temporaries left in memory share slots. The live range of one runs from
+// its first to its last instruction, stretched over every jump that leaves
+// it backwards or enters it from outside, so a value live around a loop
+// keeps its slot for the whole loop. A temporary read before it is written
+// is live in the whole function. Ranges are then given the lowest slot free
+// at their start, in start order. A slot is free again on the line of the
+// last read, the lowering loads every operand before storing the result.
+
+static uint32_t *scan_temps; // temporaries of the function, syms index
+static uint32_t scan_qty;
+static uint32_t scan_cap;
+
+static int by_first(const void *a, const void *b) {
+    const vmsym_t *x = &syms[*(const uint32_t*) a], *y = &syms[*(const uint32_t*) b];
+    if (x->first != y->first) {
+        return x->first < y->first ? -1 : 1;
+    }
+    return *(const uint32_t*) a < *(const uint32_t*) b ? -1 : 1;
+}
+
+// stretch the live ranges over the jumps of function fn, lines beg..end
+static void stretch(vmedge_t *edges, uint32_t edges_qty, uint32_t beg, uint32_t end) {
+    for (uint32_t n = 0; n < scan_qty; n++) {
+        vmsym_t *sym = &syms[scan_temps[n]];
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t i = 0; i < edges_qty; i++) {
+                uint32_t from = edges[i].from, to = edges[i].to;
+                bool inside = from >= sym->first && from <= sym->last;
+                if ((!inside && to > sym->first && to <= sym->last) || (inside && to < sym->first)) {
+                    sym->first = from < sym->first ? from : sym->first;
+                    sym->first = to < sym->first ? to : sym->first;
+                    sym->last = from > sym->last ? from : sym->last;
+                    sym->last = to > sym->last ? to : sym->last;
+                    changed = true;
+                }
+            }
+        }
+        if (sym->first < beg || sym->last > end) {
+            unlikely();
+        }
+    }
+}
+
+// linear scan of the temporaries of function fn
+static void assign_slots(long int fn) {
+    uint32_t *ends = malloc((scan_qty + 1) * sizeof(uint32_t)); // last line of each slot
+    if (ends == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+
+    if (scan_qty > 1) {
+        qsort(scan_temps, scan_qty, sizeof(uint32_t), by_first);
+    }
+    for (uint32_t n = 0; n < scan_qty; n++) {
+        vmsym_t *sym = &syms[scan_temps[n]];
+        uint32_t k = 0;
+        while (k < funs[fn].slots && ends[k] > sym->first) {
+            ++k;
+        }
+        if (k == funs[fn].slots) {
+            ++funs[fn].slots;
+        }
+        ends[k] = sym->last;
+        sym->slot = k;
+    }
+    free(ends);
+}
+
+static void share_slots(asm_result_t *irasm, uint32_t irasm_len) {
+    vmmap_t labels = { 0 };
+    vmedge_t *edges = NULL;
+    uint32_t edges_qty = 0, edges_cap = 0, beg = 0;
+    long int fn = -1;
+    int ops[3], uses[2], def;
+
+    if (!PL0E_OPT_LEVEL) {
+        return;
+    }
+
+    for (uint32_t line = 0; line < irasm_len; ++line) {
+        asm_result_t *a = &irasm[line];
+        switch (a->op) {
+            case FN_START_OP:
+                ++fn;
+                beg = line;
+                edges_qty = scan_qty = 0;
+                continue;
+            case FN_END_OP:
+                for (uint32_t n = 0; n < edges_qty; n++) {
+                    if (!map_get(&labels, edges[n].label, &edges[n].to)) {
+                        panic("UNDEFINED_LABEL");
+                    }
+                }
+                for (uint32_t n = 0; n < scan_qty; n++) {
+                    // read before written, a value from a former pass
+                    if (syms[scan_temps[n]].first == UINT32_MAX) {
+                        syms[scan_temps[n]].first = beg;
+                        syms[scan_temps[n]].last = line;
+                    }
+                }
+                stretch(edges, edges_qty, beg, line);
+                assign_slots(fn);
+                continue;
+            case LABEL_OP:
+                map_put(&labels, a->arg[0].str, line);
+                continue;
+            case JUMP_OP:
+            case BRANCH_EQU_OP:
+            case BRANCH_NEQ_OP:
+            case BRANCH_GTT_OP:
+            case BRANCH_GEQ_OP:
+            case BRANCH_LST_OP:
+            case BRANCH_LEQ_OP:
+                if (edges_qty == edges_cap) {
+                    edges_cap = edges_cap ? edges_cap * 2 : 16;
+                    edges = realloc(edges, edges_cap * sizeof(vmedge_t));
+                    if (edges == NULL) {
+                        panic("OUT_OF_MEMORY");
+                    }
+                }
+                edges[edges_qty++] = (vmedge_t) { .from = line, .label = a->arg[0].str };
+                break;
+            default:
+                break;
+        }
+
+        int qty = sym_operands(a, ops);
+        int nuses = stack_uses(a, uses, &def);
+        for (int n = 0; n < qty; n++) {
+            vmsym_t *sym = lookup(a->arg[ops[n]].str);
+            if (!sym || sym->cate != TEMP_OBJ || sym->stacked || sym->addressed || sym->escape) {
+                continue;
+            }
+
+            if (!sym->shared) {
+                sym->shared = true;
+                sym->first = line;
+                for (int u = 0; u < nuses; u++) {
+                    if (stack_sym(a, uses[u]) == sym) {
+                        sym->first = UINT32_MAX;
+                    }
+                }
+                if (scan_qty == scan_cap) {
+                    scan_cap = scan_cap ? scan_cap * 2 : 64;
+                    scan_temps = realloc(scan_temps, scan_cap * sizeof(uint32_t));
+                    if (scan_temps == NULL) {
+                        panic("OUT_OF_MEMORY");
+                    }
+                }
+                scan_temps[scan_qty++] = sym - syms;
+            }
+            sym->last = line;
+        }
+    }
+
+    free(edges);
+    free(scan_temps);
+    scan_temps = NULL;
+    scan_qty = scan_cap = 0;
+    map_free(&labels);
+}
+
+/////////////////////// lowering ///////////////////////
+
+// a recursive function with a frame pushes it on the MEM frame stack, then
+// arguments moved to MEM are copied at function entry
+static void prologue(long int fn) {
+    vmfun_t *fun = &funs[fn];
+    if (fun->frame) {
+        op32(GET_GLOBAL, fun->display);
+        set_local(fun->saved);
+        op32(GET_GLOBAL, mem_sp);
+        op32(SET_GLOBAL, fun->display);
+        op32(GET_GLOBAL, fun->display);
+        push_imm(INT_TYPE, fun->frame);
+        op0(ADD);
+        op32(SET_GLOBAL, mem_sp);
+        op32(GET_GLOBAL, mem_sp);
+        push_imm(INT_TYPE, mem_qty);
+        op0(LTE);
+        op32(GOTOZ, overflow);
+    }
+
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        vmsym_t *sym = &syms[n];
+        if (sym->fn != fn || (sym->store != MEM_STORE && sym->store != FRAME_STORE)) {
+            continue;
+        }
+        if (!is_arg(sym)) {
+            continue;
+        }
+        get_local(sym->argslot);
+        set_slot(sym);
+    }
+}
+
+// pop the frame and give the display back to the former activation
+static void epilogue(long int fn) {
+    vmfun_t *fun = &funs[fn];
+    if (fun->frame) {
+        op32(GET_GLOBAL, fun->display);
+        op32(SET_GLOBAL, mem_sp);
+        get_local(fun->saved);
+        op32(SET_GLOBAL, fun->display);
+    }
 }
 
-void irasm_to_stackvm(asm_result_t *irasm, uint32_t irasm_len, asm_result_t **stackvm_asm, uint32_t *stackvm_asm_len) {
-    correct_consecutive_operations(irasm, irasm_len, stackvm_asm, stackvm_asm_len);
+// create MEM and the frame stack and jump to main program
+static void entry(long int mainfn) {
+    if (mem_qty) {
+        uint32_t n = mem_qty;
+        while (n > 0) {
+            uint32_t chunk = n > 0xff ? 0xff : n;
+            op8(PUSH_NULL_N, chunk);
+            n -= chunk;
+        }
+        op16(NEW_ARRAY, mem_qty);
+        op32(SET_GLOBAL, STACKVM_MEMREF);
+    }
+    if (mem_sp) {
+        push_imm(INT_TYPE, mem_static);
+        op32(SET_GLOBAL, mem_sp);
+        for (long int fn = 0; fn < fn_ir_elements_qty; fn++) {
+            if (funs[fn].frame) {
+                op0(PUSH_0);
+                op32(SET_GLOBAL, funs[fn].display);
+            }
+        }
+    }
+
+    op32(GOTO, funs[mainfn].addr);
+
+    // MEM frame stack overflow
+    if (mem_sp) {
+        overflow = pc;
+        op8(HALT, STACKVM_HALT_MEMSTACK);
+    }
+}
+
+// branch to label if condition holds: GOTOZ on the negated condition
+static void lower_branch(asm_result_t *a) {
+    push_operand(a, 1, 3);
+    push_operand(a, 2, 5);
+    switch (a->op) {
+        case BRANCH_EQU_OP:
+            op0(SUB);
+            break;
+        case BRANCH_NEQ_OP:
+            op0(EQU);
+            break;
+        case BRANCH_GTT_OP:
+            op0(LTE);
+            break;
+        case BRANCH_GEQ_OP:
+            op0(LT);
+            break;
+        case BRANCH_LST_OP:
+            op0(GTE);
+            break;
+        case BRANCH_LEQ_OP:
+            op0(GT);
+            break;
+        default:
+            unlikely();
+    }
+    opjump(GOTOZ, a->arg[0].str);
+}
+
+static void lower_call(asm_result_t *a) {
+    uint32_t fn = 0;
+    if (!map_get(&funmap, a->arg[2].str, &fn)) {
+        panic("UNDEFINED_FUNCTION");
+    }
+
+    op8(CALL, funs[fn].reserve);
+    put32(emitting ? funs[fn].addr : 0);
+
+    if (irasm_str(a->arg[1].str)[0] != '\0') {
+        op0(GET_RETVAL);
+        store_operand(a, 1);
+    }
+}
+
+static void lower_write(asm_result_t *a, uint32_t lib) {
+    push_operand(a, 0, 1);
+    oplib(1, lib);
+}
+
+static void lower_read(asm_result_t *a, uint32_t lib) {
+    oplib(0, lib);
+    store_operand(a, 0);
+}
+
+static void lower(asm_result_t *irasm, uint32_t irasm_len, uint32_t code_len) {
+    long int fn = -1, mainfn = 0;
+    uint32_t addr = 0;
+
+    for (long int n = 0; n < fn_ir_elements_qty; n++) {
+        if (funs[n].main) {
+            mainfn = n;
+        }
+    }
+
+    pc = 0;
+    entry(mainfn);
+
+    for (uint32_t line = 0; line < irasm_len; ++line) {
+        asm_result_t *a = &irasm[line];
+        switch (a->op) {
+            case ADD_OP:
+            case SUB_OP:
+            case MUL_OP:
+            case DIV_OP:
+                push_operand(a, 1, 3);
+                push_operand(a, 2, 5);
+                op0(a->op == ADD_OP ? ADD : a->op == SUB_OP ? SUB : a->op == MUL_OP ? MUL : DIV);
+                store_operand(a, 0);
+                break;
+            case INC_OP:
+            case DEC_OP:
+                nevernil(lookup(a->arg[0].str));
+                load(lookup(a->arg[0].str));
+                op0(a->op == INC_OP ? INC : DEC);
+                store_operand(a, 0);
+                break;
+            case NEG_OP:
+                op0(PUSH_0);
+                push_operand(a, 1, 2);
+                op0(SUB);
+                store_operand(a, 0);
+                break;
+            case LOAD_ARRAY_OP:
+                push_element(a, 1, 2, 5);
+                mem_deref();
+                store_operand(a, 0);
+                break;
+            case STORE_VAR_OP:
+                push_operand(a, 1, 2);
+                store_operand(a, 0);
+                break;
+            case STORE_ARRAY_OP:
+                push_operand(a, 1, 3);
+                push_element(a, 0, 2, 5);
+                mem_assign();
+                break;
+            case BRANCH_EQU_OP:
+            case BRANCH_NEQ_OP:
+            case BRANCH_GTT_OP:
+            case BRANCH_GEQ_OP:
+            case BRANCH_LST_OP:
+            case BRANCH_LEQ_OP:
+                lower_branch(a);
+                break;
+            case JUMP_OP:
+                opjump(GOTO, a->arg[0].str);
+                break;
+            case PUSH_VAL_OP:
+                push_operand(a, 0, 1);
+                break;
+            case PUSH_ADDR_OP:
+                if (a->args_qty > 1) {
+                    push_element(a, 0, 1, 2);
+                } else {
+                    vmsym_t *sym = lookup(a->arg[0].str);
+                    nevernil(sym);
+                    if (sym->store == FRAME_STORE) {
+                        push_frame(sym);
+                    } else {
+                        push_imm(UINT_TYPE, sym->index);
+                    }
+                }
+                break;
+            case POP_OP:
+                op0(DROP);
+                break;
+            case CALL_OP:
+                lower_call(a);
+                break;
+            case FN_START_OP:
+                ++fn;
+                funs[fn].addr = pc;
+                prologue(fn);
+                break;
+            case FN_END_OP:
+                if (funs[fn].main) {
+                    op8(HALT, 0);
+                } else if (fn_ir_elements[fn].category == FUNCTION_OBJ) {
+                    load(lookup(fn_ir_elements[fn].label));
+                    epilogue(fn);
+                    op0(RETURN_VALUE);
+                } else {
+                    epilogue(fn);
+                    op0(RETURN);
+                }
+                break;
+            case READ_INT_OP:
+                lower_read(a, STACKVM_LIB_READ_INT);
+                break;
+            case READ_UINT_OP:
+                lower_read(a, STACKVM_LIB_READ_UINT);
+                break;
+            case READ_CHAR_OP:
+                lower_read(a, STACKVM_LIB_READ_CHAR);
+                break;
+            case WRITE_STRING_OP:
+                if (!map_get(&strmap, a->arg[0].str, &addr)) {
+                    panic("UNDEFINED_STRING");
+                }
+                op32(PUSH_CONST_STRING, code_len + addr);
+                oplib(1, STACKVM_LIB_WRITE_STRING);
+                break;
+            case WRITE_INT_OP:
+                lower_write(a, STACKVM_LIB_WRITE_INT);
+                break;
+            case WRITE_UINT_OP:
+                lower_write(a, STACKVM_LIB_WRITE_UINT);
+                break;
+            case WRITE_CHAR_OP:
+                lower_write(a, STACKVM_LIB_WRITE_CHAR);
+                break;
+            case LABEL_OP:
+                if (!emitting) {
+                    map_put(&labmap, a->arg[0].str, pc);
+                }
+                break;
+            default:
+                unlikely();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////
+
+void irasm_to_stackvm(asm_result_t *irasm, uint32_t irasm_len, stackvm_program_t *program) {
+    funs = arena_alloc(ASM_ARENA, (fn_ir_elements_qty + 1) * sizeof(vmfun_t));
+
+    collect_symbols();
+    escape_analysis(irasm, irasm_len);
+    find_recursion();
+    stackify(irasm, irasm_len);
+    share_slots(irasm, irasm_len);
+    layout();
+    chkerr("stackvm fail and exit.");
+
+    // pass 1: sizes, label and function addresses
+    emitting = false;
+    lower(irasm, irasm_len, 0);
+
+    // pass 2: emit with resolved targets
+    uint32_t code_len = pc;
+    emitting = true;
+    vminsts = 0;
+    lower(irasm, irasm_len, code_len);
+    if (pc != code_len) {
+        panic("STACKVM_PASS_MISMATCH");
+    }
+
+    // string constants
+    for (uint32_t n = 0; n < strpool_len; n++) {
+        put8(strpool[n]);
+    }
+
+    program->program = image;
+    program->program_len = pc;
+    program->entry = 0;
+    program->globals = globals_qty;
+
+    dbg("stackvm code=%u strings=%u globals=%u mem=%u frames=%u\n", code_len, strpool_len, globals_qty, mem_static, mem_qty - mem_static);
+
+    // code size and frames, the figures stackify shrinks
+    uint32_t slots = globals_qty, stacked = 0;
+    for (long int n = 0; n < fn_ir_elements_qty; n++) {
+        slots += funs[n].reserve;
+    }
+    for (uint32_t n = 0; n < syms_qty; n++) {
+        stacked += syms[n].stacked;
+    }
+    msg("; stackvm %7u instructions, %7u bytes, %5u frame slots, %5u stacked temps\n", vminsts, code_len, slots, stacked);
+
+    free(syms);
+    free(calls);
+    free(strpool);
+    map_free(&symmap);
+    map_free(&funmap);
+    map_free(&labmap);
+    map_free(&strmap);
+    syms = NULL;
+    calls = NULL;
+    funs = NULL;
+    strpool = NULL;
+    syms_qty = calls_qty = strpool_len = mem_qty = mem_static = mem_sp = overflow = vminsts = 0;
+    image = NULL;
+    image_cap = pc = 0;
+
+    phase = LINK;
+}
+
+static void write32(FILE *fp, uint32_t v) {
+    uint8_t b[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24 };
+    fwrite(b, 1, 4, fp);
+}
+
+void stackvm_write(stackvm_program_t *program, char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        panic("TARGET_FILE_OPEN_FAIL");
+    }
+
+    fwrite(STACKVM_MAGIC, 1, 4, fp);
+    write32(fp, program->entry);
+    write32(fp, program->globals);
+    write32(fp, program->program_len);
+    fwrite(program->program, 1, program->program_len, fp);
+    fclose(fp);
+
+    msg("; target %s\n", path);
+    phase = SUCCESS;
+}
 
+void stackvm_free(stackvm_program_t *program) {
+    free(program->program);
+    program->program = NULL;
+    program->program_len = 0;
 }
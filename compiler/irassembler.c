@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "atom.h"
 #include "ir.h"
 #include "common.h"
 #include "debug.h"
@@ -29,8 +30,8 @@
 //#define ENABLE_FULL_DEBUG
 
 #define PIDENT(x)           printf(";%*s", (int)strlen(x), "")
-#define ARG_STR(argn, val) strcpy(asm_result->argn.value.str, val);asm_result->argn.type = false
-#define ARG_NUM(argn, val) asm_result->argn.value.number = val;asm_result->argn.type = true
+#define ARG_STR(n, val)    asm_result->arg[n].str = irasm_strput(val);asm_result->numeric &= ~(1 << (n))
+#define ARG_NUM(n, val)    asm_result->arg[n].number = val;asm_result->numeric |= (1 << (n))
 #define ARG_QTY(qty)       asm_result->args_qty = qty
 
 static const char *category[] = {
@@ -60,17 +61,97 @@ static const char *value_type[] = {
 fn_ir_elements_t *fn_ir_elements;
 long int fn_ir_elements_qty;
 
+///////////////////// string table /////////////////////
+
+// all labels, names and string constants live in one pool,
+// irasm records refer to them by offset (irasm_str_t)
+static char *strpool = NULL;
+static uint32_t strpool_len = 0;
+static uint32_t strpool_cap = 0;
+
+// open addressing index over strpool, slot holds offset + 1 (0 is empty)
+static uint32_t *strslots = NULL;
+static uint32_t strslots_qty = 0;
+static uint32_t strslots_used = 0;
+
+// FNV-1a
+static uint32_t strhash(const char *str) {
+    uint32_t h = 2166136261u;
+    while (*str) {
+        h ^= (uint8_t) *str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void strslots_grow(void) {
+    uint32_t qty = strslots_qty ? strslots_qty * 2 : 256;
+    uint32_t *slots = calloc(qty, sizeof(uint32_t));
+    if (slots == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+
+    for (uint32_t i = 0; i < strslots_qty; i++) {
+        if (!strslots[i]) {
+            continue;
+        }
+        uint32_t n = strhash(strpool + strslots[i] - 1) & (qty - 1);
+        while (slots[n]) {
+            n = (n + 1) & (qty - 1);
+        }
+        slots[n] = strslots[i];
+    }
+
+    free(strslots);
+    strslots = slots;
+    strslots_qty = qty;
+}
+
+irasm_str_t irasm_strput(const char *str) {
+    if ((strslots_used + 1) * 2 > strslots_qty) {
+        strslots_grow();
+    }
+
+    uint32_t n = strhash(str) & (strslots_qty - 1);
+    while (strslots[n]) {
+        if (!strcmp(strpool + strslots[n] - 1, str)) {
+            return strslots[n] - 1;
+        }
+        n = (n + 1) & (strslots_qty - 1);
+    }
+
+    uint32_t len = strlen(str) + 1;
+    if (strpool_len + len > strpool_cap) {
+        while (strpool_len + len > strpool_cap) {
+            strpool_cap = strpool_cap ? strpool_cap * 2 : 4096;
+        }
+        strpool = realloc(strpool, strpool_cap);
+        if (strpool == NULL) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+
+    irasm_str_t idx = strpool_len;
+    memcpy(strpool + idx, str, len);
+    strpool_len += len;
+
+    strslots[n] = idx + 1;
+    ++strslots_used;
+
+    return idx;
+}
+
+const char* irasm_str(irasm_str_t idx) {
+    return strpool + idx;
+}
+
 #ifdef ENABLE_FULL_DEBUG
 static void print_table(symtab_t *table) {
-    printf("          { symbol table id: %d, depth: %d, name space: %s }\n", table->tid, table->depth, table->nspace);
-
-    for (int i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &table->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            printf("          { symbol id: %d, name: %s, category: %s, type: %s, value: %ld, label: %s, offset: %d }\n", e->sid, e->name, category[e->cate], value_type[e->type],
-                    e->initval, e->label, e->off);
-        }
+    printf("          { symbol table id: %d, depth: %d, name space: %s }\n", table->tid, table->depth, atom_str(table->nspace));
+
+    for (syment_t *e = table->ehead; e; e = e->next) {
+        printf("          { symbol id: %d, name: %s, category: %s, type: %s, value: %ld, label: %s, offset: %d }\n", e->sid, atom_str(e->name), category[e->cate], value_type[e->type],
+                e->initval, symlabel(e), e->off);
     }
     printf("          { argument offset: %d, variable offset: %d, temp offset: %d }\n", table->argoff, table->varoff, table->tmpoff);
 }
@@ -81,13 +162,12 @@ static void print_syment(syment_t *symbol) {
 
     printf("      [symbol entry]\n");
     printf("        { symbol id: %d, ", symbol->sid);
-    printf("name: %s, ", symbol->name);
+    printf("name: %s, ", atom_str(symbol->name));
     printf("category: %s, ", category[symbol->cate]);
     printf("type: %s, ", value_type[symbol->type]);
     printf("initval: %ld, ", symbol->initval);
     printf("arrlen: %d, ", symbol->arrlen);
-    printf("string: %s, ", strlen(symbol->str) == 0 ? "NULL" : symbol->str);
-    printf("label: %s, ", symbol->label);
+    printf("label: %s, ", symlabel(symbol));
     printf("offset: %d, ", symbol->off);
     printf("line number: %d }\n", symbol->lineno);
 
@@ -115,31 +195,24 @@ static void head(syment_t *symbol) {
     printf("      [end head]\n");
 }
 
+static void print_opnd(char *which, opnd_t *o) {
+    printf("    [arg %s]\n", which);
+    if (o->kind == SYM_OPND) {
+        head(o->sym);
+        print_syment(o->sym);
+    } else if (HASOPND(*o)) {
+        printf("      { operand: %s, type: %s, value: %ld }\n", opndlabel(o), value_type[o->type], opndval(o));
+    } else {
+        printf("      { NONE }\n");
+    }
+    printf("    [end arg %s]\n", which);
+}
+
 static void print_args(inst_t *instruction) {
     printf ("  [args]\n");
-    if (instruction->d != NULL) {
-        printf("    [arg d]\n");
-        head(instruction->d);
-        print_syment(instruction->d);
-        printf("    [end arg d]\n");
-    } else
-        printf("    [arg d]\n      { NONE }\n    [end arg d]\n");
-
-    if (instruction->r != NULL) {
-        printf("    [arg r]\n");
-        head(instruction->r);
-        print_syment(instruction->r);
-        printf("    [end arg r]\n");
-    } else
-        printf("    [arg r]\n      { NONE }\n    [end arg r]\n");
-
-    if (instruction->s != NULL) {
-        printf("    [arg s]\n");
-        head(instruction->s);
-        print_syment(instruction->s);
-        printf("    [end arg s]\n");
-    } else
-        printf("    [arg s]\n      { NONE }\n    [end arg s]\n");
+    print_opnd("d", &instruction->d);
+    print_opnd("r", &instruction->r);
+    print_opnd("s", &instruction->s);
     printf ("  [end args]\n");
 }
 #endif
@@ -161,15 +234,15 @@ static void fn_args(syment_t *symbol, uint32_t ident) {
     while (head != NULL) {
         fn_ir_elements[fn_ir_elements_qty].args = realloc(fn_ir_elements[fn_ir_elements_qty].args, (fn_ir_elements[fn_ir_elements_qty].args_qty + 1) * sizeof(fn_ir_args_t));
 
-        strcpy(fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].name, head->symbol->name);
-        strcpy(fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].label, head->symbol->label);
+        fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].name = irasm_strput(atom_str(head->symbol->name));
+        fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].label = irasm_strput(symlabel(head->symbol));
         fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].type = head->symbol->type;
         fn_ir_elements[fn_ir_elements_qty].args[fn_ir_elements[fn_ir_elements_qty].args_qty].category = head->symbol->cate;
         ++fn_ir_elements[fn_ir_elements_qty].args_qty;
 
 #ifdef ENABLE_DEBUG
-        printf(";%*s%s %u %u ; %s %s %s\n", ident + 2, "", head->symbol->label, head->symbol->cate == BY_VALUE_OBJ ? 0 : 1, head->symbol->type,
-                head->symbol->name, category[head->symbol->cate], value_type[head->symbol->type]);
+        printf(";%*s%s %u %u ; %s %s %s\n", ident + 2, "", symlabel(head->symbol), head->symbol->cate == BY_VALUE_OBJ ? 0 : 1, head->symbol->type,
+                atom_str(head->symbol->name), category[head->symbol->cate], value_type[head->symbol->type]);
 #endif
         head = head->next;
     }
@@ -183,24 +256,21 @@ static void fn_locales(symtab_t *table, uint32_t ident) {
     printf(";%*s[locale]\n", ident, "");
 #endif
 
-    for (int i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &table->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            if (e->cate == VARIABLE_OBJ || e->cate == ARRAY_OBJ) {
-                fn_ir_elements[fn_ir_elements_qty].locales = realloc(fn_ir_elements[fn_ir_elements_qty].locales,
-                        (fn_ir_elements[fn_ir_elements_qty].locales_qty + 1) * sizeof(fn_ir_locales_t));
-                strcpy(fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].name, e->name);
-                strcpy(fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].label, e->label);
-                fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].type = e->type;
-                fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].category = e->cate;
-                ++fn_ir_elements[fn_ir_elements_qty].locales_qty;
+    for (syment_t *e = table->ehead; e; e = e->next) {
+        if (e->cate == VARIABLE_OBJ || e->cate == ARRAY_OBJ) {
+            fn_ir_elements[fn_ir_elements_qty].locales = realloc(fn_ir_elements[fn_ir_elements_qty].locales,
+                    (fn_ir_elements[fn_ir_elements_qty].locales_qty + 1) * sizeof(fn_ir_locales_t));
+            fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].name = irasm_strput(atom_str(e->name));
+            fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].label = irasm_strput(symlabel(e));
+            fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].type = e->type;
+            fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].category = e->cate;
+            fn_ir_elements[fn_ir_elements_qty].locales[fn_ir_elements[fn_ir_elements_qty].locales_qty].length = e->arrlen;
+            ++fn_ir_elements[fn_ir_elements_qty].locales_qty;
 
 #ifdef ENABLE_DEBUG
-                printf(";%*s%s %u %u ; %s %s %s\n", ident + 2, "", e->label, e->cate == ARRAY_OBJ ? 1 : 0, e->type, e->name, category[e->cate],
-                        value_type[e->type]);
+            printf(";%*s%s %u %u ; %s %s %s\n", ident + 2, "", symlabel(e), e->cate == ARRAY_OBJ ? 1 : 0, e->type, atom_str(e->name), category[e->cate],
+                    value_type[e->type]);
 #endif
-            }
         }
     }
 
@@ -214,24 +284,19 @@ static void fn_temps(symtab_t *table, uint32_t ident) {
     printf(";%*s[temp]\n", ident, "");
 #endif
 
-    for (int i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &table->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            if (e->cate == TEMP_OBJ) {
-                fn_ir_elements[fn_ir_elements_qty].temps = realloc(fn_ir_elements[fn_ir_elements_qty].temps,
-                        (fn_ir_elements[fn_ir_elements_qty].temps_qty + 1) * sizeof(fn_ir_temps_t));
-                strcpy(fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].name, e->name);
-                strcpy(fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].label, e->label);
-                fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].type = e->type;
-                fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].category = e->cate;
-                ++fn_ir_elements[fn_ir_elements_qty].temps_qty;
+    for (int i = 0; i < table->tmpoff; i++) {
+        tmpent_t *t = &table->temps[i];
+        fn_ir_elements[fn_ir_elements_qty].temps = realloc(fn_ir_elements[fn_ir_elements_qty].temps,
+                (fn_ir_elements[fn_ir_elements_qty].temps_qty + 1) * sizeof(fn_ir_temps_t));
+        fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].name = irasm_strput(atom_str(t->text));
+        fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].label = irasm_strput(mklabel(TEMP_OBJ, t->id));
+        fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].type = t->type;
+        fn_ir_elements[fn_ir_elements_qty].temps[fn_ir_elements[fn_ir_elements_qty].temps_qty].category = TEMP_OBJ;
+        ++fn_ir_elements[fn_ir_elements_qty].temps_qty;
 
 #ifdef ENABLE_DEBUG
-                printf(";%*s%s %u; %s %s\n", ident + 2, "", e->label, e->type, e->name, value_type[e->type]);
+        printf(";%*s%s %u; %s %s\n", ident + 2, "", mklabel(TEMP_OBJ, t->id), t->type, atom_str(t->text), value_type[t->type]);
 #endif
-            }
-        }
     }
 
 #ifdef ENABLE_DEBUG
@@ -244,22 +309,17 @@ static void fn_strings(symtab_t *table, uint32_t ident) {
     printf(";%*s[string]\n", ident, "");
 #endif
 
-    for (int i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &table->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            if (e->cate == STRING_OBJ) {
-                fn_ir_elements[fn_ir_elements_qty].strings = realloc(fn_ir_elements[fn_ir_elements_qty].strings,
-                        (fn_ir_elements[fn_ir_elements_qty].strings_qty + 1) * sizeof(fn_ir_strings_t));
-                strcpy(fn_ir_elements[fn_ir_elements_qty].strings[fn_ir_elements[fn_ir_elements_qty].strings_qty].label, e->label);
-                strcpy(fn_ir_elements[fn_ir_elements_qty].strings[fn_ir_elements[fn_ir_elements_qty].strings_qty].value, e->str);
-                ++fn_ir_elements[fn_ir_elements_qty].strings_qty;
+    for (int i = 0; i < table->strqty; i++) {
+        tmpent_t *t = &table->strs[i];
+        fn_ir_elements[fn_ir_elements_qty].strings = realloc(fn_ir_elements[fn_ir_elements_qty].strings,
+                (fn_ir_elements[fn_ir_elements_qty].strings_qty + 1) * sizeof(fn_ir_strings_t));
+        fn_ir_elements[fn_ir_elements_qty].strings[fn_ir_elements[fn_ir_elements_qty].strings_qty].label = irasm_strput(mklabel(STRING_OBJ, t->id));
+        fn_ir_elements[fn_ir_elements_qty].strings[fn_ir_elements[fn_ir_elements_qty].strings_qty].value = irasm_strput(atom_str(t->text));
+        ++fn_ir_elements[fn_ir_elements_qty].strings_qty;
 
 #ifdef ENABLE_DEBUG
-                printf(";%*s%s \"%s\"\n", ident + 2, "", e->label, e->str);
+        printf(";%*s%s \"%s\"\n", ident + 2, "", mklabel(STRING_OBJ, t->id), atom_str(t->text));
 #endif
-            }
-        }
     }
 
 #ifdef ENABLE_DEBUG
@@ -272,36 +332,37 @@ static void fn_strings(symtab_t *table, uint32_t ident) {
 static void asmbl_fn_start_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("name%*s args vars tmps label\n", (int) strlen(instruction->d->name) - 4, "");
-    printf("%s %s %04d %04d %04d %s\n", opcode[instruction->op], instruction->d->name, instruction->d->scope->argoff, instruction->d->scope->varoff, instruction->d->scope->tmpoff,
-            instruction->d->label);
-#endif
-    ARG_STR(arg1, instruction->d->name);
-    ARG_NUM(arg2, instruction->d->scope->argoff);
-    ARG_NUM(arg3, instruction->d->scope->varoff);
-    ARG_NUM(arg4, instruction->d->scope->tmpoff);
-    ARG_STR(arg5, instruction->d->label);
+    printf("name%*s args vars tmps label\n", (int) strlen(atom_str(instruction->d.sym->name)) - 4, "");
+    printf("%s %s %04d %04d %04d %s\n", opcode[instruction->op], atom_str(instruction->d.sym->name), instruction->d.sym->scope->argoff, instruction->d.sym->scope->varoff, instruction->d.sym->scope->tmpoff,
+            opndlabel(&instruction->d));
+#endif
+    ARG_STR(0, atom_str(instruction->d.sym->name));
+    ARG_NUM(1, instruction->d.sym->scope->argoff);
+    ARG_NUM(2, instruction->d.sym->scope->varoff);
+    ARG_NUM(3, instruction->d.sym->scope->tmpoff);
+    ARG_STR(4, opndlabel(&instruction->d));
     ARG_QTY(5);
 
     fn_ir_elements = realloc(fn_ir_elements, (fn_ir_elements_qty + 1) * sizeof(fn_ir_elements_t));
-    strcpy(fn_ir_elements[fn_ir_elements_qty].name, instruction->d->name);
-    strcpy(fn_ir_elements[fn_ir_elements_qty].label, instruction->d->label);
+    fn_ir_elements[fn_ir_elements_qty].name = irasm_strput(atom_str(instruction->d.sym->name));
+    fn_ir_elements[fn_ir_elements_qty].label = irasm_strput(opndlabel(&instruction->d));
+    fn_ir_elements[fn_ir_elements_qty].category = opndcate(&instruction->d);
 
     fn_ir_elements[fn_ir_elements_qty].args = malloc(sizeof(fn_ir_args_t));
     fn_ir_elements[fn_ir_elements_qty].args_qty = 0;
-    fn_args(instruction->d, (int) strlen(opcode[instruction->op]));
+    fn_args(instruction->d.sym, (int) strlen(opcode[instruction->op]));
 
     fn_ir_elements[fn_ir_elements_qty].locales = malloc(sizeof(fn_ir_locales_t));
     fn_ir_elements[fn_ir_elements_qty].locales_qty = 0;
-    fn_locales(instruction->d->scope, (int) strlen(opcode[instruction->op]));
+    fn_locales(instruction->d.sym->scope, (int) strlen(opcode[instruction->op]));
 
     fn_ir_elements[fn_ir_elements_qty].temps = malloc(sizeof(fn_ir_temps_t));
     fn_ir_elements[fn_ir_elements_qty].temps_qty = 0;
-    fn_temps(instruction->d->scope, (int) strlen(opcode[instruction->op]));
+    fn_temps(instruction->d.sym->scope, (int) strlen(opcode[instruction->op]));
 
     fn_ir_elements[fn_ir_elements_qty].strings = malloc(sizeof(fn_ir_strings_t));
     fn_ir_elements[fn_ir_elements_qty].strings_qty = 0;
-    fn_strings(instruction->d->scope, (int) strlen(opcode[instruction->op]));
+    fn_strings(instruction->d.sym->scope, (int) strlen(opcode[instruction->op]));
 
     ++fn_ir_elements_qty;
 
@@ -319,10 +380,10 @@ static void asmbl_fn_end_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("name\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->name);
+    printf("%s %s\n", opcode[instruction->op], atom_str(instruction->d.sym->name));
 #endif
-    ARG_STR(arg1, instruction->d->name);
-    ARG_STR(arg2, instruction->d->label);
+    ARG_STR(0, atom_str(instruction->d.sym->name));
+    ARG_STR(1, opndlabel(&instruction->d));
     ARG_QTY(2);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -336,16 +397,16 @@ static void asmbl_fn_end_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_add_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1 %*sarg2\n", (int) strlen(instruction->d->label) - 2, "", (int) strlen(instruction->d->label) - 4, "");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("to%*s arg1 %*sarg2\n", (int) strlen(opndlabel(&instruction->d)) - 2, "", (int) strlen(opndlabel(&instruction->d)) - 4, "");
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -359,16 +420,16 @@ static void asmbl_add_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_sub_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1 %*sarg2\n", (int) strlen(instruction->d->label) - 2, "", (int) strlen(instruction->d->label) - 4, "");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("to%*s arg1 %*sarg2\n", (int) strlen(opndlabel(&instruction->d)) - 2, "", (int) strlen(opndlabel(&instruction->d)) - 4, "");
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -382,16 +443,16 @@ static void asmbl_sub_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_mul_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1 %*sarg2\n", (int) strlen(instruction->d->label) - 2, "", (int) strlen(instruction->d->label) - 4, "");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("to%*s arg1 %*sarg2\n", (int) strlen(opndlabel(&instruction->d)) - 2, "", (int) strlen(opndlabel(&instruction->d)) - 4, "");
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -405,16 +466,16 @@ static void asmbl_mul_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_div_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1 %*sarg2\n", (int) strlen(instruction->d->label) - 2, "", (int) strlen(instruction->d->label) - 4, "");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("to%*s arg1 %*sarg2\n", (int) strlen(opndlabel(&instruction->d)) - 2, "", (int) strlen(opndlabel(&instruction->d)) - 4, "");
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -429,9 +490,9 @@ static void asmbl_inc_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -446,9 +507,9 @@ static void asmbl_dec_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -462,12 +523,14 @@ static void asmbl_dec_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_neg_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1\n", (int) strlen(instruction->d->label) - 2, "");
-    printf("%s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label);
+    printf("to%*s arg1\n", (int) strlen(opndlabel(&instruction->d)) - 2, "");
+    printf("%s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_QTY(2);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_NUM(2, instruction->r.type);
+    ARG_NUM(3, opndval(&instruction->r));
+    ARG_QTY(4);
 #ifdef ENABLE_DEBUG
     printf("\n");
 #endif
@@ -481,15 +544,15 @@ static void asmbl_load_array_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("to   arry indx\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -503,13 +566,13 @@ static void asmbl_load_array_op(inst_t *instruction, asm_result_t *asm_result) {
 static void asmbl_store_var_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
-    printf("to%*s arg1\n", (int) strlen(instruction->d->label) - 2, "");
-    printf("%s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label);
+    printf("to%*s arg1\n", (int) strlen(opndlabel(&instruction->d)) - 2, "");
+    printf("%s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_NUM(arg3, instruction->r->type);
-    ARG_NUM(arg4, instruction->r->initval);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_NUM(2, instruction->r.type);
+    ARG_NUM(3, opndval(&instruction->r));
     ARG_QTY(4);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -524,15 +587,15 @@ static void asmbl_store_array_op(inst_t *instruction, asm_result_t *asm_result)
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arry val1 indx\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -547,15 +610,15 @@ static void asmbl_branch_equ_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -570,15 +633,15 @@ static void asmbl_branch_neq_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -593,15 +656,15 @@ static void asmbl_branch_gtt_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -616,15 +679,15 @@ static void asmbl_branch_geq_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -639,15 +702,15 @@ static void asmbl_branch_lst_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -662,15 +725,15 @@ static void asmbl_branch_leq_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl arg1 arg2\n");
-    printf("%s %s %s %s\n", opcode[instruction->op], instruction->d->label, instruction->r->label, instruction->s->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_STR(arg2, instruction->r->label);
-    ARG_STR(arg3, instruction->s->label);
-    ARG_NUM(arg4, instruction->r->type);
-    ARG_NUM(arg5, instruction->r->initval);
-    ARG_NUM(arg6, instruction->s->type);
-    ARG_NUM(arg7, instruction->s->initval);
+    printf("%s %s %s %s\n", opcode[instruction->op], opndlabel(&instruction->d), opndlabel(&instruction->r), opndlabel(&instruction->s));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_STR(1, opndlabel(&instruction->r));
+    ARG_STR(2, opndlabel(&instruction->s));
+    ARG_NUM(3, instruction->r.type);
+    ARG_NUM(4, opndval(&instruction->r));
+    ARG_NUM(5, instruction->s.type);
+    ARG_NUM(6, opndval(&instruction->s));
     ARG_QTY(7);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -685,9 +748,9 @@ static void asmbl_jump_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -702,11 +765,11 @@ static void asmbl_push_val_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_NUM(arg2, instruction->d->type);
-    ARG_NUM(arg3, instruction->d->initval);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_NUM(1, instruction->d.type);
+    ARG_NUM(2, opndval(&instruction->d));
     ARG_QTY(3);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -721,10 +784,17 @@ static void asmbl_push_addr_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
-#endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_QTY(1);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
+#endif
+    ARG_STR(0, opndlabel(&instruction->d));
+    if (HASOPND(instruction->r)) {
+        ARG_STR(1, opndlabel(&instruction->r));
+        ARG_NUM(2, instruction->r.type);
+        ARG_NUM(3, opndval(&instruction->r));
+        ARG_QTY(4);
+    } else {
+        ARG_QTY(1);
+    }
 #ifdef ENABLE_DEBUG
     printf("\n");
 #endif
@@ -750,15 +820,16 @@ static void asmbl_call_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("func\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->r->name);
+    printf("%s %s\n", opcode[instruction->op], atom_str(instruction->r.sym->name));
 #endif
-    ARG_STR(arg1, instruction->r->name);
-    if (instruction->d != NULL) {
-        ARG_STR(arg2, instruction->d->label);
+    ARG_STR(0, atom_str(instruction->r.sym->name));
+    if (HASOPND(instruction->d)) {
+        ARG_STR(1, opndlabel(&instruction->d));
     } else {
-        ARG_STR(arg2, "");
+        ARG_STR(1, "");
     }
-    ARG_QTY(2);
+    ARG_STR(2, opndlabel(&instruction->r));
+    ARG_QTY(3);
 #ifdef ENABLE_DEBUG
     printf("\n");
 #endif
@@ -772,9 +843,9 @@ static void asmbl_read_int_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -789,9 +860,9 @@ static void asmbl_read_uint_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -806,9 +877,9 @@ static void asmbl_read_char_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -823,9 +894,9 @@ static void asmbl_write_string_op(inst_t *instruction, asm_result_t *asm_result)
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -840,12 +911,12 @@ static void asmbl_write_int_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_NUM(arg2, instruction->d->type);
-    ARG_NUM(arg3, instruction->d->initval);
-    ARG_NUM(arg4, instruction->d->cate);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_NUM(1, instruction->d.type);
+    ARG_NUM(2, opndval(&instruction->d));
+    ARG_NUM(3, opndcate(&instruction->d));
     ARG_QTY(4);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -860,12 +931,12 @@ static void asmbl_write_uint_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_NUM(arg2, instruction->d->type);
-    ARG_NUM(arg3, instruction->d->initval);
-    ARG_NUM(arg4, instruction->d->cate);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_NUM(1, instruction->d.type);
+    ARG_NUM(2, opndval(&instruction->d));
+    ARG_NUM(3, opndcate(&instruction->d));
     ARG_QTY(4);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -880,12 +951,12 @@ static void asmbl_write_char_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("arg1\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
-    ARG_NUM(arg2, instruction->d->type);
-    ARG_NUM(arg3, instruction->d->initval);
-    ARG_NUM(arg4, instruction->d->cate);
+    ARG_STR(0, opndlabel(&instruction->d));
+    ARG_NUM(1, instruction->d.type);
+    ARG_NUM(2, opndval(&instruction->d));
+    ARG_NUM(3, opndcate(&instruction->d));
     ARG_QTY(4);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -900,9 +971,9 @@ static void asmbl_label_op(inst_t *instruction, asm_result_t *asm_result) {
 #ifdef ENABLE_DEBUG
     PIDENT(opcode[instruction->op]);
     printf("labl\n");
-    printf("%s %s\n", opcode[instruction->op], instruction->d->label);
+    printf("%s %s\n", opcode[instruction->op], opndlabel(&instruction->d));
 #endif
-    ARG_STR(arg1, instruction->d->label);
+    ARG_STR(0, opndlabel(&instruction->d));
     ARG_QTY(1);
 #ifdef ENABLE_DEBUG
     printf("\n");
@@ -918,15 +989,25 @@ static void asmbl_label_op(inst_t *instruction, asm_result_t *asm_result) {
 uint32_t gen_irasm(asm_result_t **irasm_result) {
     inst_t *instruction;
     uint32_t irasm_result_len = 0;
+    uint32_t irasm_result_cap = 0;
     asm_result_t *ir_result = NULL;
 
     fn_ir_elements = calloc(1, sizeof(fn_ir_elements_t));
     fn_ir_elements_qty = 0;
 
-    for (instruction = xhead; instruction; instruction = instruction->next) {
-        *irasm_result = realloc((*irasm_result), (irasm_result_len + 1) * sizeof(asm_result_t));
-        (*irasm_result)[irasm_result_len].op = instruction->op;
+    for (int i = 0; i < instqty; i++) {
+        instruction = &insts[i];
+        // amortized growth
+        if (irasm_result_len == irasm_result_cap) {
+            irasm_result_cap = irasm_result_cap ? irasm_result_cap * 2 : 256;
+            *irasm_result = realloc((*irasm_result), irasm_result_cap * sizeof(asm_result_t));
+            if (*irasm_result == NULL) {
+                panic("OUT_OF_MEMORY");
+            }
+        }
         ir_result = &((*irasm_result)[irasm_result_len]);
+        memset(ir_result, 0, sizeof(asm_result_t));
+        ir_result->op = instruction->op;
 
         switch (instruction->op) {
         case ADD_OP:
@@ -1041,32 +1122,32 @@ void print_ir_fn_elements(void) {
     long int fn;
 
     for (fn = 0; fn < fn_ir_elements_qty; fn++) {
-        printf("fn_label %s %s\n", fn_ir_elements[fn].name, fn_ir_elements[fn].label);
+        printf("fn_label %s %s\n", irasm_str(fn_ir_elements[fn].name), irasm_str(fn_ir_elements[fn].label));
 
         for (long int args = 0; args < fn_ir_elements[fn].args_qty; args++) {
-            printf("fn_arg %s %s ", fn_ir_elements[fn].name, fn_ir_elements[fn].args[args].label);
+            printf("fn_arg %s %s ", irasm_str(fn_ir_elements[fn].name), irasm_str(fn_ir_elements[fn].args[args].label));
             printf("%s ", category[fn_ir_elements[fn].args[args].category]);
             printf("%s ", value_type[fn_ir_elements[fn].args[args].type]);
-            printf("%s\n", fn_ir_elements[fn].args[args].name);
+            printf("%s\n", irasm_str(fn_ir_elements[fn].args[args].name));
         }
 
         for (long int locales = 0; locales < fn_ir_elements[fn].locales_qty; locales++) {
-            printf("fn_locale %s %s ", fn_ir_elements[fn].name, fn_ir_elements[fn].locales[locales].label);
+            printf("fn_locale %s %s ", irasm_str(fn_ir_elements[fn].name), irasm_str(fn_ir_elements[fn].locales[locales].label));
             printf("%s ", category[fn_ir_elements[fn].locales[locales].category]);
             printf("%s ", category[fn_ir_elements[fn].locales[locales].type]);
-            printf("%s\n", fn_ir_elements[fn].locales[locales].name);
+            printf("%s\n", irasm_str(fn_ir_elements[fn].locales[locales].name));
         }
 
         for (long int temps = 0; temps < fn_ir_elements[fn].temps_qty; temps++) {
-            printf("fn_temp %s %s ", fn_ir_elements[fn].name, fn_ir_elements[fn].temps[temps].label);
+            printf("fn_temp %s %s ", irasm_str(fn_ir_elements[fn].name), irasm_str(fn_ir_elements[fn].temps[temps].label));
             printf("%s ", category[fn_ir_elements[fn].temps[temps].category]);
             printf("%s ", category[fn_ir_elements[fn].temps[temps].type]);
-            printf("%s\n", fn_ir_elements[fn].temps[temps].name);
+            printf("%s\n", irasm_str(fn_ir_elements[fn].temps[temps].name));
         }
 
         for (long int strings = 0; strings < fn_ir_elements[fn].strings_qty; strings++) {
-            printf("fn_string %s %s ", fn_ir_elements[fn].name, fn_ir_elements[fn].strings[strings].label);
-            printf("\"%s\"\n", fn_ir_elements[fn].strings[strings].value);
+            printf("fn_string %s %s ", irasm_str(fn_ir_elements[fn].name), irasm_str(fn_ir_elements[fn].strings[strings].label));
+            printf("\"%s\"\n", irasm_str(fn_ir_elements[fn].strings[strings].value));
         }
 
         printf("\n");
@@ -1080,223 +1161,223 @@ void print_irasm(asm_result_t *irasm_result, uint32_t irasm_result_len) {
         printf("%s ", opcode[a.op]);
         switch (a.op) {
             case ADD_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case SUB_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case MUL_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case DIV_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case INC_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case DEC_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case NEG_OP:
-                printf("%s %s\n", a.arg1.value.str, a.arg2.value.str);
+                printf("%s %s\n", IRASM_STR(a, 0), IRASM_STR(a, 1));
                 break;
             case LOAD_ARRAY_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case STORE_VAR_OP:
-                if (a.arg3.value.number == LITERAL_TYPE)
-                    printf("%s %ld\n", a.arg1.value.str, a.arg4.value.number);
+                if (a.arg[2].number == LITERAL_TYPE)
+                    printf("%s %d\n", IRASM_STR(a, 0), a.arg[3].number);
                 else
-                    printf("%s %s\n", a.arg1.value.str, a.arg2.value.str);
+                    printf("%s %s\n", IRASM_STR(a, 0), IRASM_STR(a, 1));
                 break;
             case STORE_ARRAY_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_EQU_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_NEQ_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_GTT_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_GEQ_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_LST_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case BRANCH_LEQ_OP:
-                printf("%s ", a.arg1.value.str);
-                if (a.arg4.value.number == LITERAL_TYPE)
-                    printf("%ld ", a.arg5.value.number);
+                printf("%s ", IRASM_STR(a, 0));
+                if (a.arg[3].number == LITERAL_TYPE)
+                    printf("%d ", a.arg[4].number);
                 else
-                    printf("%s ", a.arg2.value.str);
+                    printf("%s ", IRASM_STR(a, 1));
 
-                if (a.arg6.value.number == LITERAL_TYPE)
-                    printf("%ld \n", a.arg7.value.number);
+                if (a.arg[5].number == LITERAL_TYPE)
+                    printf("%d \n", a.arg[6].number);
                 else
-                    printf("%s \n", a.arg3.value.str);
+                    printf("%s \n", IRASM_STR(a, 2));
                 break;
             case JUMP_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case PUSH_VAL_OP:
-                if (a.arg2.value.number == LITERAL_TYPE)
-                    printf("%ld\n", a.arg3.value.number);
+                if (a.arg[1].number == LITERAL_TYPE)
+                    printf("%d\n", a.arg[2].number);
                 else
-                    printf("%s\n", a.arg1.value.str);
+                    printf("%s\n", IRASM_STR(a, 0));
                 break;
             case PUSH_ADDR_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case POP_OP:
                 printf("\n");
                 break;
             case CALL_OP:
-                printf("%s %s\n", a.arg1.value.str, a.arg2.value.str);
+                printf("%s %s\n", IRASM_STR(a, 0), IRASM_STR(a, 1));
                 break;
             case FN_START_OP:
-                printf("%s %ld %ld %ld %s\n", a.arg1.value.str, a.arg2.value.number, a.arg3.value.number, a.arg4.value.number, a.arg5.value.str);
+                printf("%s %d %d %d %s\n", IRASM_STR(a, 0), a.arg[1].number, a.arg[2].number, a.arg[3].number, IRASM_STR(a, 4));
                 break;
             case FN_END_OP:
-                printf("%s %s\n\n", a.arg1.value.str, a.arg2.value.str);
+                printf("%s %s\n\n", IRASM_STR(a, 0), IRASM_STR(a, 1));
                 break;
             case READ_INT_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case READ_UINT_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case READ_CHAR_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
             case WRITE_STRING_OP:
-                if (a.arg2.value.number == LITERAL_TYPE)
-                    printf("%ld\n", a.arg3.value.number);
+                if (a.arg[1].number == LITERAL_TYPE)
+                    printf("%d\n", a.arg[2].number);
                 else
-                    printf("%s\n", a.arg1.value.str);
+                    printf("%s\n", IRASM_STR(a, 0));
                 break;
             case WRITE_INT_OP:
-                if (a.arg4.value.number == NUMBER_OBJ)
-                    printf("%ld\n", a.arg3.value.number);
+                if (a.arg[3].number == NUMBER_OBJ)
+                    printf("%d\n", a.arg[2].number);
                 else
-                    printf("%s\n", a.arg1.value.str);
+                    printf("%s\n", IRASM_STR(a, 0));
                 break;
             case WRITE_UINT_OP:
-                if (a.arg4.value.number == NUMBER_OBJ)
-                    printf("%ld\n", a.arg3.value.number);
+                if (a.arg[3].number == NUMBER_OBJ)
+                    printf("%d\n", a.arg[2].number);
                 else
-                    printf("%s\n", a.arg1.value.str);
+                    printf("%s\n", IRASM_STR(a, 0));
                 break;
             case WRITE_CHAR_OP:
-                if (a.arg4.value.number == NUMBER_OBJ)
-                    printf("%ld\n", a.arg3.value.number);
+                if (a.arg[3].number == NUMBER_OBJ)
+                    printf("%d\n", a.arg[2].number);
                 else
-                    printf("%s\n", a.arg1.value.str);
+                    printf("%s\n", IRASM_STR(a, 0));
                 break;
             case LABEL_OP:
-                printf("%s\n", a.arg1.value.str);
+                printf("%s\n", IRASM_STR(a, 0));
                 break;
         }
 
@@ -1312,4 +1393,12 @@ void free_irasm(void) {
         free(fn_ir_elements[fn].strings);
     }
     free(fn_ir_elements);
+
+    // free string table
+    free(strpool);
+    free(strslots);
+    strpool = NULL;
+    strslots = NULL;
+    strpool_len = strpool_cap = 0;
+    strslots_qty = strslots_used = 0;
 }
@@ -15,10 +15,12 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
-#include "optimize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
+#include "irassembler.h"
+#include "optimize.h"
 
 // define the global module
 mod_t mod;
@@ -26,47 +28,162 @@ mod_t mod;
 // re-generated instruction counter
 int xidcnt2 = 500;
 
+static double elapsed(struct timespec *beg) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - beg->tv_sec) + (end.tv_nsec - beg->tv_nsec) / 1e9;
+}
+
+// optimizer pass
+typedef struct _pass_struct {
+    char *name;        // name in the report
+    int level;         // lowest -O level running the pass
+    void (*run)(void); // run the pass on the module
+} pass_t;
+
+static void cfg_pass(void) {
+    partition_basic_blocks();
+    construct_flow_graph();
+}
+
+// passes in running order, tail and inline rewrite the IR vector, dag and
+// lva the blocks they go through, layout reorders them
+static pass_t passes[] = {
+        { "tail", 1, tail_optim },
+        { "inline", 1, inline_optim },
+        { "cfg", 1, cfg_pass },
+        { "dag", 1, dag_optim },
+        { "lva", 2, lva_optim },
+        { "layout", 1, layout_optim },
+};
+
+// instructions of the module, the IR vector until the blocks are made
+static int modqty(void) {
+    if (!mod.fhead) {
+        return instqty;
+    }
+
+    int qty = 0;
+    for (fun_t *fun = mod.fhead; fun; fun = fun->next) {
+        qty += 2;
+        for (bb_t *bb = fun->bhead; bb; bb = bb->next) {
+            qty += bb->total;
+        }
+    }
+    return qty;
+}
+
+// rebuild the IR vector from the blocks, in block order
+static void relink(void) {
+    inst_t *old = ir_detach();
+    for (fun_t *fun = mod.fhead; fun; fun = fun->next) {
+        emit1(FN_START_OP, fun->entry);
+        for (bb_t *bb = fun->bhead; bb; bb = bb->next) {
+            for (int i = 0; i < bb->total; ++i) {
+                inst_t *x = &bb->insts[i];
+                emit3(x->op, x->d, x->r, x->s);
+            }
+        }
+        emit1(FN_END_OP, fun->entry);
+    }
+    free(old);
+}
+
 void optim(void) {
-    // make flow graph
+    struct timespec beg;
+    int qty = instqty;
+
+    for (size_t i = 0; i < sizeof(passes) / sizeof(pass_t); ++i) {
+        if (passes[i].level > PL0E_OPT_LEVEL) {
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &beg);
+        passes[i].run();
+        double secs = elapsed(&beg);
+
+        int after = modqty();
+        msg("; pass %-6s %7d -> %7d instructions (%+d) in %.3f ms\n", passes[i].name, qty, after, after - qty, secs * 1e3);
+        qty = after;
+    }
+
+    // the code generator reads the IR vector
+    if (mod.fhead) {
+        relink();
+    }
+}
+
+void irbench(void) {
+    struct timespec beg;
+    double tasm, tcfg, tdag, tlva;
+    asm_result_t *irasm = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    uint32_t qty = gen_irasm(&irasm);
+    tasm = elapsed(&beg);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
     partition_basic_blocks();
     construct_flow_graph();
+    tcfg = elapsed(&beg);
 
-    // DAG optimization
+    clock_gettime(CLOCK_MONOTONIC, &beg);
     dag_optim();
+    tdag = elapsed(&beg);
 
-    // Live Variables Analysis
+    clock_gettime(CLOCK_MONOTONIC, &beg);
     lva_optim();
+    tlva = elapsed(&beg);
+
+    printf("; ir %u instructions: gen_irasm %.3f ms, optimizer %.3f ms (cfg %.3f, dag %.3f, lva %.3f)\n", qty, tasm * 1e3,
+            (tcfg + tdag + tlva) * 1e3, tcfg * 1e3, tdag * 1e3, tlva * 1e3);
+
+    free_irasm();
+    free(irasm);
+}
+
+void sset(fun_t *fun, bits_t bits[], opnd_t *o) {
+    bset(bits, fun->varidx[o->id] - 1);
 }
 
-void sset(bits_t bits[], syment_t *e) {
-    bset(bits, e->sid);
+bool sget(fun_t *fun, bits_t bits[], opnd_t *o) {
+    return fun->varidx[o->id] && bget(bits, fun->varidx[o->id] - 1);
 }
 
-bool sget(bits_t bits[], syment_t *e) {
-    return bget(bits, e->sid);
+void sdel(fun_t *fun, bits_t bits[], opnd_t *o) {
+    bclr(bits, fun->varidx[o->id] - 1);
 }
 
-void sdup(bits_t des[], bits_t src[]) {
-    bdup(des, src, NBITARR);
+void sdup(fun_t *fun, bits_t des[], bits_t src[]) {
+    bdup(des, src, fun->nwords);
 }
 
-void sclr(bits_t *bits) {
-    bclrall(bits, NBITARR);
+void sclr(fun_t *fun, bits_t *bits) {
+    bclrall(bits, fun->nwords);
 }
 
-bool ssame(bits_t a[], bits_t b[]) {
-    return bsame(a, b, NBITARR);
+bool ssame(fun_t *fun, bits_t a[], bits_t b[]) {
+    return bsame(a, b, fun->nwords);
 }
 
-void sunion(bits_t *r, bits_t *a, bits_t *b) {
-    bunion(r, a, b, NBITARR);
+void sunion(fun_t *fun, bits_t *r, bits_t *a, bits_t *b) {
+    bunion(r, a, b, fun->nwords);
 }
 
-void ssub(bits_t *r, bits_t *a, bits_t *b) {
-    bsub(r, a, b, NBITARR);
+void ssub(fun_t *fun, bits_t *r, bits_t *a, bits_t *b) {
+    bsub(r, a, b, fun->nwords);
 }
 
-inst_t* dupinst(op_t op, syment_t *d, syment_t *r, syment_t *s) {
+bool stransfer(fun_t *fun, bits_t *r, bits_t *use, bits_t *out, bits_t *def) {
+    return btransfer(r, use, out, def, fun->nwords);
+}
+
+// empty set
+bits_t* snew(fun_t *fun) {
+    return arena_alloc(OPTIM_ARENA, fun->nwords * sizeof(bits_t));
+}
+
+inst_t* dupinst(op_t op, opnd_t d, opnd_t r, opnd_t s) {
     inst_t *x;
     NEWINST(x);
     x->op = op;
@@ -76,3 +193,26 @@ inst_t* dupinst(op_t op, syment_t *d, syment_t *r, syment_t *s) {
     x->d = d;
     return x;
 }
+
+void bbcommit(bb_t *bb, inst_t **v, int qty) {
+    inst_t *insts = arena_alloc(OPTIM_ARENA, qty * sizeof(inst_t));
+    for (int i = 0; i < qty; ++i) {
+        insts[i] = *v[i];
+    }
+    bb->insts = insts;
+    bb->total = qty;
+}
+
+void* optgrow(void *v, int qty, int *cap, size_t size) {
+    if (qty < *cap) {
+        return v;
+    }
+
+    // the old array stays in the arena, doubling bounds the waste
+    *cap = *cap ? *cap * 2 : 4;
+    void *grown = arena_alloc(OPTIM_ARENA, *cap * size);
+    if (qty) {
+        memcpy(grown, v, qty * size);
+    }
+    return grown;
+}
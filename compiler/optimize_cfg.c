@@ -20,22 +20,20 @@
 #include "debug.h"
 #include "ir.h"
 #include "limits.h"
-
-extern void **memtrack;
-extern unsigned long memtrack_qty;
+#include "symtab.h"
 
 // basic block counter
 static int bbcnt = 0;
 
 // point to the current function scope
 static fun_t *thefunc;
-// leader of current basic block
-static inst_t *leader;
+// leader of current basic block, index in insts
+static int leader;
 
 // create a function object
 static fun_t* create_function_object(void) {
     fun_t *fun;
-    INITMEM(fun_t, fun);
+    INITMEM(OPTIM_ARENA, fun_t, fun);
 
     if (mod.fhead) {
         mod.ftail->next = fun;
@@ -44,14 +42,15 @@ static fun_t* create_function_object(void) {
         mod.fhead = mod.ftail = fun;
     }
 
-    fun->scope = leader->d->scope;
+    fun->scope = insts[leader].d.sym->scope;
+    fun->entry = insts[leader].d;
     return fun;
 }
 
 // create a basic block
 static bb_t* create_basic_block(void) {
     bb_t *bb;
-    INITMEM(bb_t, bb);
+    INITMEM(OPTIM_ARENA, bb_t, bb);
     bb->bid = ++bbcnt;
     if (thefunc->bhead) {
         thefunc->btail->next = bb;
@@ -62,16 +61,14 @@ static bb_t* create_basic_block(void) {
     bb->fun = thefunc;
 
     dbg("CREATE B%d\n", bb->bid);
-    for (inst_t *x = leader; x; x = x->next) {
-        if (bb->total >= MAXBBINST) {
-            panic("BASIC_BLOCK_INSTRUCTION_OVERFLOW");
-        }
-        bb->insts[bb->total++] = x;
-        dbg("B%d ADD_QUAD: #%03d %s d=%s r=%s s=%s\n", bb->bid, x->xid, opcode[x->op], x->d ? x->d->label : "NONE", x->r ? x->r->label : "NONE",
-                x->s ? x->s->label : "NONE");
-
-        leader = x->next;
-        if (!leader) {
+    bb->insts = &insts[leader];
+    while (leader < instqty) {
+        inst_t *x = &insts[leader++];
+        bb->total++;
+        dbg("B%d ADD_QUAD: #%03d %s d=%s r=%s s=%s\n", bb->bid, x->xid, opcode[x->op], HASOPND(x->d) ? opndlabel(&x->d) : "NONE",
+                HASOPND(x->r) ? opndlabel(&x->r) : "NONE", HASOPND(x->s) ? opndlabel(&x->s) : "NONE");
+
+        if (leader == instqty) {
             goto ok;
         }
 
@@ -80,7 +77,7 @@ static bb_t* create_basic_block(void) {
         //     2. unconditional jump
         //     3. a label
         //     4. function enter/finish
-        switch (leader->op) {
+        switch (insts[leader].op) {
             case BRANCH_EQU_OP:
             case BRANCH_NEQ_OP:
             case BRANCH_GTT_OP:
@@ -120,19 +117,19 @@ ok:
 // partition into basic blocks
 void partition_basic_blocks(void) {
     dbg("PARTITION BB\n");
-    leader = xhead;
-    while (leader) {
-        switch (leader->op) {
+    leader = 0;
+    while (leader < instqty) {
+        switch (insts[leader].op) {
             case FN_START_OP:
                 thefunc = create_function_object();
-                leader = leader->next;
+                leader++;
                 break;
             case FN_END_OP:
-                if (thefunc->scope != leader->d->scope) {
+                if (thefunc->scope != insts[leader].d.sym->scope) {
                     panic("ENTER_FINISH_NOT_MATCH");
                 }
                 thefunc = NULL;
-                leader = leader->next;
+                leader++;
                 break;
             default:
                 create_basic_block();
@@ -140,21 +137,35 @@ void partition_basic_blocks(void) {
     }
 }
 
+// lab2bb[..] map label to basic block pointer
+//    key:   label id
+//    value: bb_t pointer
+// labels are never shared between functions, so one map serves them all
+static bb_t **lab2bb;
+
+// link from -> to, once
+static void link_edge(bb_t *from, bb_t *to) {
+    for (int i = 0; i < from->succcnt; ++i) {
+        if (from->succ[i] == to) {
+            return;
+        }
+    }
+    from->succ = optgrow(from->succ, from->succcnt, &from->succcap, sizeof(bb_t*));
+    from->succ[from->succcnt++] = to;
+    to->pred = optgrow(to->pred, to->predcnt, &to->predcap, sizeof(bb_t*));
+    to->pred[to->predcnt++] = from;
+}
+
 // link basic block in function object
 static void link_basic_block(fun_t *fun) {
-    // lab2bb[..] map label to basic block pointer
-    //    key:   label->sid
-    //    value: bb_t pointer
-    bb_t *lab2bb[MAXSYMENT];
-
     bb_t *bb = NULL, *prev = NULL;
 
     // Step1: make lab2bb[...] map, create x->succ[0], x->pred[0] link
     for (bb = fun->bhead; bb; bb = bb->next) {
         // make lab2bb[...] map
-        inst_t *x = bb->insts[0];
+        inst_t *x = &bb->insts[0];
         if (x->op == LABEL_OP) {
-            lab2bb[x->d->sid] = bb;
+            lab2bb[x->d.id] = bb;
         }
 
         // create succ[0], pred[0] link
@@ -162,17 +173,15 @@ static void link_basic_block(fun_t *fun) {
             prev = bb;
             continue;
         }
-        prev->succ[0] = bb;
-        bb->pred[0] = prev;
+        link_edge(prev, bb);
         prev = bb;
     }
 
     bb_t *target = NULL;
-    int i;
 
     // Step2: make jump label links
     for (bb = fun->bhead; bb; bb = bb->next) {
-        inst_t *x = bb->insts[bb->total - 1];
+        inst_t *x = &bb->insts[bb->total - 1];
         switch (x->op) {
             case BRANCH_EQU_OP:
             case BRANCH_NEQ_OP:
@@ -182,25 +191,8 @@ static void link_basic_block(fun_t *fun) {
             case BRANCH_LEQ_OP:
             case JUMP_OP:
                 // get target basic block
-                target = lab2bb[x->d->sid];
-                // link bb->succ[...]
-                for (i = 0; i < MAXBBLINK; ++i) {
-                    if (!bb->succ[i]) {
-                        bb->succ[i] = target;
-                    }
-                    if (bb->succ[i] == target) {
-                        break;
-                    }
-                }
-                // link target->pred[...]
-                for (i = 0; i < MAXBBLINK; ++i) {
-                    if (!target->pred[i]) {
-                        target->pred[i] = bb;
-                    }
-                    if (target->pred[i] == bb) {
-                        break;
-                    }
-                }
+                target = lab2bb[x->d.id];
+                link_edge(bb, target);
                 break;
             default:
                 continue;
@@ -212,6 +204,7 @@ static void link_basic_block(fun_t *fun) {
 void construct_flow_graph(void) {
     dbg("CONSTRUCT FLOW GRAPH\n");
     fun_t *fun;
+    lab2bb = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(bb_t*));
     for (fun = mod.fhead; fun; fun = fun->next) {
         link_basic_block(fun);
     }
@@ -15,6 +15,8 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
+#include <stdlib.h>
+
 #include "common.h"
 #include "debug.h"
 #include "ir.h"
@@ -22,95 +24,112 @@
 #include "optimize.h"
 #include "symtab.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 // the DAG counter
 static int graphcnt = 0;
 // the DAG nodes counter
 static int nodecnt = 0;
 
-// check instructions in basic block is dagable
-static bool check_dagable(bb_t *bb) {
-    inst_t *x;
-    int i;
-    for (i = 0; i < bb->total; ++i) {
-        x = bb->insts[i];
-        switch (x->op) {
-            case STORE_ARRAY_OP:
-            case PUSH_VAL_OP:
-            case PUSH_ADDR_OP:
-            case POP_OP:
-            case CALL_OP:
-            case READ_INT_OP:
-            case READ_UINT_OP:
-            case READ_CHAR_OP:
-            case WRITE_STRING_OP:
-            case WRITE_INT_OP:
-            case WRITE_UINT_OP:
-            case WRITE_CHAR_OP:
-                return false;
-            default:
-                continue;
-        }
+// test if instruction x stays out of the DAG, it splits the DAG of its block.
+// These are the instructions with side effects, the control flow and the
+// stores through a reference, which may change any variable
+static bool is_barrier(inst_t *x) {
+    switch (x->op) {
+        case ADD_OP:
+        case SUB_OP:
+        case MUL_OP:
+        case DIV_OP:
+        case NEG_OP:
+        case LOAD_ARRAY_OP:
+            return false;
+        case STORE_VAR_OP:
+            return opndcate(&x->d) == BY_REFERENCE_OBJ;
+        default:
+            return true;
     }
-    return true;
+}
+
+// append x to the instructions after DAG optim
+static void addinst2(bb_t *bb, inst_t *x) {
+    bb->insts2 = optgrow(bb->insts2, bb->inst2cnt, &bb->inst2cap, sizeof(inst_t*));
+    bb->insts2[bb->inst2cnt++] = x;
 }
 
 // create DAG node
 static dnode_t* create_dag_node(dgraph_t *g, dnode_cate_t cate) {
     dnode_t *node;
-    INITMEM(dnode_t, node);
+    INITMEM(OPTIM_ARENA, dnode_t, node);
 
     // init common attrs
     node->nid = ++nodecnt;
     node->cate = cate;
 
     // add node to graph
+    g->nodes = optgrow(g->nodes, g->nodecnt, &g->nodecap, sizeof(dnode_t*));
     g->nodes[g->nodecnt++] = node;
     return node;
 }
 
-// create DAG graph
-static dgraph_t* create_dag_graph(void) {
+// operand map of the graph being built, mapping id to node
+static dnode_t **symmap = NULL;
+
+// create DAG graph for len instructions
+static dgraph_t* create_dag_graph(int len) {
     dgraph_t *graph;
-    INITMEM(dgraph_t, graph);
+    INITMEM(OPTIM_ARENA, dgraph_t, graph);
     graph->gid = ++graphcnt;
+
+    // an instruction adds one operation node at most, keep the table half empty
+    graph->tabsize = 8;
+    while (graph->tabsize < 2 * len) {
+        graph->tabsize *= 2;
+    }
+    graph->table = arena_alloc(OPTIM_ARENA, graph->tabsize * sizeof(dnode_t*));
     return graph;
 }
 
-// lookup leaf node, for symbol
-static dnode_t* find_leaf(dgraph_t *g, syment_t *e) {
-    dnode_t *node = g->symmap[e->sid];
+// map operand o to node
+static void map_symbol(dgraph_t *g, opnd_t *o, dnode_t *node) {
+    if (!symmap[o->id]) {
+        g->syms = optgrow(g->syms, g->symcnt, &g->symcap, sizeof(opnd_t));
+        g->syms[g->symcnt++] = *o;
+    }
+    symmap[o->id] = node;
+}
+
+// lookup leaf node, for operand
+static dnode_t* find_leaf(dgraph_t *g, opnd_t *o) {
+    dnode_t *node = symmap[o->id];
 
     // insert new one node if not found
     if (!node) {
         node = create_dag_node(g, SYMBOLNODE);
-        node->syment = e;
+        node->opnd = *o;
 
         // add to symmap
-        g->symmap[e->sid] = node;
+        map_symbol(g, o, node);
     }
 
     return node;
 }
 
-// lookup non leaf node, for opertion
-static dnode_t* find_nonleaf(dgraph_t *g, op_t op, dnode_t *lhs, dnode_t *rhs) {
+// hash of an operation node key
+static uint32_t nodehash(op_t op, dnode_t *lhs, dnode_t *rhs) {
+    uint32_t h = (uint32_t) op * 0x9e3779b1u;
+    h ^= (uint32_t) (lhs ? lhs->nid : 0) * 0x85ebca6bu;
+    h ^= (uint32_t) (rhs ? rhs->nid : 0) * 0xc2b2ae35u;
+    return h ^ (h >> 16);
+}
+
+// lookup non leaf node, for opertion. *found tells if it was there
+static dnode_t* find_nonleaf(dgraph_t *g, op_t op, dnode_t *lhs, dnode_t *rhs, bool *found) {
+    uint32_t mask = g->tabsize - 1;
+    uint32_t n = nodehash(op, lhs, rhs) & mask;
     dnode_t *node;
-    int i;
-    for (i = 0; i < g->nodecnt; ++i) {
-        node = g->nodes[i];
-        if (node->lhs != lhs) {
-            continue;
-        }
-        if (node->rhs != rhs) {
-            continue;
-        }
-        if (node->op != op) {
-            continue;
+    for (; (node = g->table[n]); n = (n + 1) & mask) {
+        if (node->op == op && node->lhs == lhs && node->rhs == rhs) {
+            *found = true;
+            return node;
         }
-        return node;
     }
 
     // insert new one if not found
@@ -118,156 +137,123 @@ static dnode_t* find_nonleaf(dgraph_t *g, op_t op, dnode_t *lhs, dnode_t *rhs) {
     node->lhs = lhs;
     node->rhs = rhs;
     node->op = op;
+    g->table[n] = node;
 
+    *found = false;
     return node;
 }
 
-// construct DAG for the basic block
-static void construct_graph(bb_t *bb) {
-    dgraph_t *graph = create_dag_graph();
+// a store to variable o may change what the references read, forget them
+static void kill_references(dgraph_t *g, opnd_t *o) {
+    if (o->kind != SYM_OPND) {
+        return;
+    }
+    for (int i = 0; i < g->symcnt; ++i) {
+        if (opndcate(&g->syms[i]) == BY_REFERENCE_OBJ) {
+            symmap[g->syms[i].id] = NULL;
+        }
+    }
+}
+
+// DAG of instructions beg..end-1 of the basic block, re-generated as it is
+// built. An operation node is named by the temporary the first instruction
+// computing it defined, the temporaries are assigned once so the name holds
+// the value up to the end of the block. The instructions computing a node
+// again become copies of it
+static dgraph_t* construct_graph(bb_t *bb, int beg, int end) {
+    dgraph_t *graph = create_dag_graph(end - beg);
+    bool found;
 
     int i;
-    for (i = 0; i < bb->total; ++i) {
+    for (i = beg; i < end; ++i) {
         dnode_t *lhs = NULL, *rhs = NULL, *out = NULL;
-        inst_t *x = bb->insts[i];
+        inst_t *x = &bb->insts[i];
         switch (x->op) {
             case ADD_OP:
             case SUB_OP:
             case MUL_OP:
             case DIV_OP:
             case LOAD_ARRAY_OP:
-                lhs = find_leaf(graph, x->r);
-                rhs = find_leaf(graph, x->s);
-                out = find_nonleaf(graph, x->op, lhs, rhs);
-                break;
-            case INC_OP:
-            case DEC_OP:
-                lhs = find_leaf(graph, x->d);
-                out = find_nonleaf(graph, x->op, lhs, rhs);
+                lhs = find_leaf(graph, &x->r);
+                rhs = find_leaf(graph, &x->s);
+                out = find_nonleaf(graph, x->op, lhs, rhs, &found);
                 break;
             case NEG_OP:
-            case STORE_VAR_OP:
-                lhs = find_leaf(graph, x->r);
-                out = find_nonleaf(graph, x->op, lhs, rhs);
-                break;
-            case STORE_ARRAY_OP:
-            case PUSH_VAL_OP:
-            case PUSH_ADDR_OP:
-            case POP_OP:
-            case CALL_OP:
-            case FN_START_OP:
-            case FN_END_OP:
-            case READ_INT_OP:
-            case READ_UINT_OP:
-            case READ_CHAR_OP:
-            case WRITE_STRING_OP:
-            case WRITE_INT_OP:
-            case WRITE_UINT_OP:
-            case WRITE_CHAR_OP:
-                panic("UNSUPPORT_INSTRUCTION");
+                lhs = find_leaf(graph, &x->r);
+                out = find_nonleaf(graph, x->op, lhs, rhs, &found);
                 break;
-            case BRANCH_EQU_OP:
-            case BRANCH_NEQ_OP:
-            case BRANCH_GTT_OP:
-            case BRANCH_GEQ_OP:
-            case BRANCH_LST_OP:
-            case BRANCH_LEQ_OP:
-            case JUMP_OP:
-            case LABEL_OP:
-            default:
+            case STORE_VAR_OP:
+                // a store names no node, the variable takes the value
+                lhs = find_leaf(graph, &x->r);
+                addinst2(bb, dupinst(STORE_VAR_OP, x->d, lhs->opnd, NOOPND));
+                kill_references(graph, &x->d);
+
+                // unless the value lives in a variable, which may change
+                out = lhs;
+                if (lhs->cate == SYMBOLNODE && isvar(&lhs->opnd)) {
+                    out = create_dag_node(graph, SYMBOLNODE);
+                    out->opnd = x->d;
+                }
+                map_symbol(graph, &x->d, out);
                 continue;
+            default:
+                panic("UNSUPPORT_INSTRUCTION");
+        }
+
+        if (found) {
+            addinst2(bb, dupinst(STORE_VAR_OP, x->d, out->opnd, NOOPND));
+        } else {
+            out->opnd = x->d;
+            addinst2(bb, dupinst(x->op, x->d, lhs->opnd, rhs ? rhs->opnd : NOOPND));
         }
 
         // update output symbol
-        graph->symmap[x->d->sid] = out;
+        map_symbol(graph, &x->d, out);
     }
 
-    bb->dag = graph;
+    // clear symmap for the next graph
+    for (i = 0; i < graph->symcnt; ++i) {
+        symmap[graph->syms[i].id] = NULL;
+    }
+
+    return graph;
 }
 
-// build referred variables
-static void build_referred_info(dgraph_t *g) {
-    dnode_t *v = NULL;
-    syment_t *e = NULL;
+// DAG of each run of instructions between barriers, the barriers are kept
+// in place
+static void dag_block(bb_t *bb) {
+    dgraph_t **link = &bb->dag;
+    int beg = 0;
     int i;
-    for (i = 0; i < MAXDAGNODES; ++i) {
-        v = g->symmap[i];
-        if (!v) {
+    for (i = 0; i <= bb->total; ++i) {
+        if (i < bb->total && !is_barrier(&bb->insts[i])) {
             continue;
         }
-        e = syments[i];
 
-        dnvar_t *p;
-        INITMEM(dnvar_t, p);
-        p->sym = e;
-
-        // set symbol reference
-        if (!v->syment) {
-            v->syment = e;
+        if (i > beg) {
+            dgraph_t *g = construct_graph(bb, beg, i);
+            *link = g;
+            link = &g->next;
         }
 
-        // head-insert to reflist
-        p->next = v->reflist;
-        v->reflist = p;
-    }
-}
-
-static void gen_curr_node(bb_t *bb, dnode_t *n) {
-    if (n->generated) {
-        return;
-    }
-
-    // if is symbol/leaf node, skip
-    if (n->cate == SYMBOLNODE) {
-        return;
-    }
-
-    // now is OPERNODE
-    if (n->lhs) {
-        gen_curr_node(bb, n->lhs);
-    }
-    if (n->rhs) {
-        gen_curr_node(bb, n->rhs);
-    }
-
-    // duplicate instruction
-    syment_t *r = n->lhs ? n->lhs->syment : NULL;
-    syment_t *s = n->rhs ? n->rhs->syment : NULL;
-    inst_t *x = dupinst(n->op, n->syment, r, s);
-
-    if (bb->inst2cnt >= MAXBBINST) {
-        panic("DAG_REGEN_INSTRUCTION_OVERFLOW");
-    }
-    bb->insts2[bb->inst2cnt++] = x;
-    n->generated = true;
-}
-
-// re-generate instructions
-static void regen_instructions(bb_t *bb) {
-    dgraph_t *g = bb->dag;
-    dnode_t *n = NULL;
-    int i;
-    for (i = 0; i < g->nodecnt; ++i) {
-        n = g->nodes[i];
-        if (n->generated) {
-            continue;
+        if (i < bb->total) {
+            inst_t *x = &bb->insts[i];
+            addinst2(bb, dupinst(x->op, x->d, x->r, x->s));
         }
-        gen_curr_node(bb, n);
+        beg = i + 1;
     }
 }
 
 void dag_optim(void) {
     fun_t *fun;
     bb_t *bb;
+
+    symmap = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(dnode_t*));
     for (fun = mod.fhead; fun; fun = fun->next) {
         for (bb = fun->bhead; bb; bb = bb->next) {
-            if (!check_dagable(bb)) {
-                continue;
-            }
             dbg("DAG OPTIMIZATION: bb=B%d\n", bb->bid);
-            construct_graph(bb);
-            build_referred_info(bb->dag);
-            regen_instructions(bb);
+            dag_block(bb);
+            bbcommit(bb, bb->insts2, bb->inst2cnt);
         }
     }
 }
@@ -0,0 +1,508 @@
+/*
+ * @optimize_inline.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "optimize.h"
+#include "debug.h"
+#include "global.h"
+#include "ir.h"
+#include "limits.h"
+#include "symtab.h"
+
+// Inlining
+//
+// A call site of a leaf procedure or function, one calling nobody, is
+// replaced by a copy of the callee body when the cost model takes it:
+//   - the body is at most the inline limit, in IR instructions
+//   - the limit doubles for each loop around the call site, up to four
+//     times, a call in a loop runs its overhead on every iteration
+//   - the only call site of a callee takes four times the limit, the
+//     callee goes away with it
+// A callee with local arrays or nested procedures is kept out of line.
+//
+// The copy runs in the frame of the caller: locals, temporaries and labels
+// of the callee get new ones of the caller, its return value is the
+// temporary the CALL wrote. The arguments are bound where they were
+// pushed:
+//   - by value: the temporary or immediate pushed when the callee never
+//     writes the parameter, else a copy made at the push
+//   - by reference to a variable: the variable itself
+//   - by reference to a[i]: the array and the index taken at the push,
+//     each read of the parameter loads the element and each write stores
+//     it, so aliases as swap(a[i], a[i]) see every write as they did
+//     through the address
+// Rounds repeat while a call is inlined, the callers of the callees gone
+// can be leaves now. A callee with all its call sites inlined is dropped.
+
+// rounds at most
+#define INLINE_ROUNDS 3
+// limit doubles per loop up to this depth
+#define INLINE_DEPTH 2
+// locals of a caller (not main) inlining stops at, CALL reserves 255
+#define INLINE_FRAME 192
+
+// function of the IR vector
+typedef struct _infun_struct {
+    syment_t *sym;
+    int beg;      // FN_START index
+    int end;      // FN_END index
+    int calls;    // call sites
+    int inlined;  // call sites inlined
+    bool leaf;    // calls nobody, no local array or nested procedure
+} infun_t;
+
+// call site inlined
+typedef struct _site_struct {
+    infun_t *callee;
+    symtab_t *scope; // caller scope
+    opnd_t ret;      // temporary the CALL wrote
+    opnd_t *args;    // argument, by parameter number
+    opnd_t *idx;     // index of an element passed by reference, or none
+} site_t;
+
+// the IR vector of the round, read while the next one is emitted
+static inst_t *src;
+static int srcqty;
+
+static infun_t *funs;
+static int funqty;
+static infun_t **byid; // function sid => funs[...]
+
+// per instruction of the IR vector
+static int *depth;      // loops around it
+static site_t **siteof; // CALL or push of an inlined site, its site
+static int *argof;      // push: parameter number
+static bool *drop;      // POP of an inlined site
+
+// locals, temporaries and labels of the callee copied, by id. Valid when
+// the stamp is the copy's one
+static int *stamps;
+static opnd_t *to;
+static int stampcnt;
+static int idqty; // ids known to the round, the callee ones
+
+static int inline_limit(void) {
+    if (PL0E_OPT_INLINE_LIMIT >= 0) {
+        return PL0E_OPT_INLINE_LIMIT;
+    }
+    return PL0E_OPT_LEVEL >= 2 ? 16 : 8;
+}
+
+static bool ismain(syment_t *e) {
+    return !strcmp(atom_str(e->name), MAINFUNC);
+}
+
+static bool isjump(op_t op) {
+    switch (op) {
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+        case JUMP_OP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// the functions of the IR vector and the leaves among them
+static void scan_functions(void) {
+    funs = arena_alloc(OPTIM_ARENA, (srcqty / 2 + 1) * sizeof(infun_t));
+    byid = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(infun_t*));
+    funqty = 0;
+
+    infun_t *f = NULL;
+    for (int i = 0; i < srcqty; ++i) {
+        inst_t *x = &src[i];
+        switch (x->op) {
+            case FN_START_OP:
+                f = &funs[funqty++];
+                f->sym = x->d.sym;
+                f->beg = i;
+                f->leaf = !ismain(f->sym);
+                byid[f->sym->sid] = f;
+                for (syment_t *e = f->sym->scope->ehead; e; e = e->next) {
+                    if (e->cate == ARRAY_OBJ || e->cate == PROC_OBJ || e->cate == FUNCTION_OBJ) {
+                        f->leaf = false;
+                    }
+                }
+                break;
+            case FN_END_OP:
+                f->end = i;
+                break;
+            case CALL_OP:
+                f->leaf = false;
+                break;
+            default:
+                break;
+        }
+    }
+    // a nested procedure can call the one it is in, declared after it
+    for (int i = 0; i < srcqty; ++i) {
+        if (src[i].op == CALL_OP) {
+            byid[src[i].r.sym->sid]->calls++;
+        }
+    }
+}
+
+// loop depth of every instruction: the back jumps around it
+static void loop_depth(void) {
+    int *labat = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(int));
+    depth = arena_alloc(OPTIM_ARENA, (srcqty + 1) * sizeof(int));
+
+    for (int i = 0; i < srcqty; ++i) {
+        if (src[i].op == LABEL_OP) {
+            labat[src[i].d.id] = i;
+        }
+    }
+    // depth[] holds the differences first
+    for (int i = 0; i < srcqty; ++i) {
+        if (isjump(src[i].op) && labat[src[i].d.id] < i) {
+            depth[labat[src[i].d.id]]++;
+            depth[i + 1]--;
+        }
+    }
+    for (int i = 1; i < srcqty; ++i) {
+        depth[i] += depth[i - 1];
+    }
+}
+
+// the cost model
+static bool worth(infun_t *callee, int line) {
+    int limit = inline_limit();
+    int size = callee->end - callee->beg - 1;
+    int d = depth[line] < INLINE_DEPTH ? depth[line] : INLINE_DEPTH;
+
+    if (size <= limit << d) {
+        return true;
+    }
+    return callee->calls == 1 && size <= limit * 4;
+}
+
+static int params(infun_t *callee) {
+    int qty = 0;
+    for (param_t *p = callee->sym->phead; p; p = p->next) {
+        ++qty;
+    }
+    return qty;
+}
+
+// parameter number of e in the callee, -1 if e is not one
+static int paramof(infun_t *callee, syment_t *e) {
+    int n = 0;
+    for (param_t *p = callee->sym->phead; p; p = p->next, ++n) {
+        if (p->symbol == e) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+// choose the call sites of function f to inline, true if any
+static bool choose(infun_t *f) {
+    int *pushes = arena_alloc(OPTIM_ARENA, (f->end - f->beg) * sizeof(int));
+    int qty = 0;
+    int grown = 0; // temporaries the copies can add, one per instruction at most
+    bool any = false;
+    symtab_t *scope = f->sym->scope;
+
+    for (int i = f->beg + 1; i < f->end; ++i) {
+        inst_t *x = &src[i];
+        if (x->op == PUSH_VAL_OP || x->op == PUSH_ADDR_OP) {
+            pushes[qty++] = i;
+            continue;
+        }
+        if (x->op != CALL_OP) {
+            continue;
+        }
+
+        infun_t *callee = byid[x->r.sym->sid];
+        int args = params(callee);
+        qty -= args;
+        if (qty < 0) {
+            unlikely();
+        }
+
+        if (!callee->leaf || callee == f || !worth(callee, i)) {
+            continue;
+        }
+        int size = callee->end - callee->beg - 1 + args;
+        if (!ismain(f->sym) && scope->varoff + scope->tmpoff + grown + size >= INLINE_FRAME) {
+            continue;
+        }
+        grown += size;
+        for (int n = 1; n <= args; ++n) {
+            if (src[i + n].op != POP_OP) {
+                unlikely();
+            }
+        }
+
+        site_t *site;
+        INITMEM(OPTIM_ARENA, site_t, site);
+        site->callee = callee;
+        site->scope = scope;
+        site->ret = x->d;
+        site->args = arena_alloc(OPTIM_ARENA, (args + 1) * sizeof(opnd_t));
+        site->idx = arena_alloc(OPTIM_ARENA, (args + 1) * sizeof(opnd_t));
+        siteof[i] = site;
+        // the first argument is pushed last
+        for (int n = 0; n < args; ++n) {
+            siteof[pushes[qty + args - 1 - n]] = site;
+            argof[pushes[qty + args - 1 - n]] = n;
+            drop[i + 1 + n] = true;
+        }
+        callee->inlined++;
+        any = true;
+        dbg("INLINE: %s into %s\n", atom_str(callee->sym->name), atom_str(f->sym->name));
+    }
+    return any;
+}
+
+////////////////////// copying /////////////////////////
+
+static bool bound(int id) {
+    return id < idqty && stamps[id] == stampcnt;
+}
+
+static void bind(int id, opnd_t v) {
+    stamps[id] = stampcnt;
+    to[id] = v;
+}
+
+// the callee writes parameter e
+static bool writes(infun_t *callee, syment_t *e) {
+    for (int i = callee->beg + 1; i < callee->end; ++i) {
+        inst_t *x = &src[i];
+        if (x->d.kind == SYM_OPND && x->d.sym == e) {
+            switch (x->op) {
+                case WRITE_INT_OP:
+                case WRITE_UINT_OP:
+                case WRITE_CHAR_OP:
+                    break;
+                default:
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+// bind the parameter of the push x to the argument
+static void copy_arg(site_t *site, int pos, inst_t *x) {
+    param_t *p = site->callee->sym->phead;
+    for (int n = 0; n < pos; ++n) {
+        p = p->next;
+    }
+    syment_t *e = p->symbol;
+
+    opnd_t v = x->d, idx = NOOPND;
+
+    switch (e->cate) {
+        case BY_VALUE_OBJ:
+            if ((v.kind != VREG_OPND && v.kind != IMM_OPND) || writes(site->callee, e)) {
+                v = vregopnd(site->scope, "@inline/arg", e->type);
+                emit2(STORE_VAR_OP, v, x->d);
+            }
+            break;
+        case BY_REFERENCE_OBJ:
+            // the index of an element is taken now, a write of the callee
+            // to the index variable moves nothing
+            idx = x->r;
+            if (HASOPND(idx) && idx.kind == SYM_OPND) {
+                idx = vregopnd(site->scope, "@inline/idx", x->r.type);
+                emit2(STORE_VAR_OP, idx, x->r);
+            }
+            break;
+        default:
+            unlikely();
+    }
+    site->args[pos] = v;
+    site->idx[pos] = idx;
+}
+
+// string constant id of the callee scope
+static atom_t strtext(symtab_t *stab, int id) {
+    for (int i = 0; i < stab->strqty; ++i) {
+        if (stab->strs[i].id == id) {
+            return stab->strs[i].text;
+        }
+    }
+    unlikely();
+    return 0;
+}
+
+// operand o of the callee as the copy in the caller sees it
+static opnd_t remap(site_t *site, opnd_t o) {
+    symtab_t *stab = site->callee->sym->scope;
+
+    if (bound(o.id)) {
+        return to[o.id];
+    }
+    switch (o.kind) {
+        case SYM_OPND:
+            if (o.sym == site->callee->sym) {
+                return site->ret;
+            }
+            if (o.sym->stab != stab) {
+                return o;
+            }
+            if (o.sym->cate == BY_VALUE_OBJ || o.sym->cate == BY_REFERENCE_OBJ) {
+                return site->args[paramof(site->callee, o.sym)];
+            }
+            if (o.sym->cate != VARIABLE_OBJ) {
+                return o;
+            }
+            bind(o.id, vregopnd(site->scope, "@inline/var", o.type));
+            break;
+        case VREG_OPND:
+            bind(o.id, vregopnd(site->scope, "@inline/temp", o.type));
+            break;
+        case LABEL_OPND:
+            bind(o.id, labelopnd());
+            break;
+        case STR_OPND:
+            bind(o.id, stropnd(site->scope, strtext(stab, o.id)));
+            break;
+        default:
+            return o;
+    }
+    return to[o.id];
+}
+
+// parameter number of o when bound to an array element, else -1
+static int elemof(site_t *site, opnd_t *o) {
+    if (o->kind != SYM_OPND || o->sym->cate != BY_REFERENCE_OBJ || o->sym->stab != site->callee->sym->scope) {
+        return -1;
+    }
+    int n = paramof(site->callee, o->sym);
+    return HASOPND(site->idx[n]) ? n : -1;
+}
+
+// read operand o, an element is loaded first
+static opnd_t use(site_t *site, opnd_t o) {
+    int n = elemof(site, &o);
+    if (n < 0) {
+        return remap(site, o);
+    }
+    opnd_t t = vregopnd(site->scope, "@inline/elem", o.type);
+    emit3(LOAD_ARRAY_OP, t, site->args[n], site->idx[n]);
+    return t;
+}
+
+// copy instruction x of the callee
+static void copy_inst(site_t *site, inst_t *x) {
+    opnd_t d = x->d, r = use(site, x->r), s = use(site, x->s);
+
+    int n = elemof(site, &d);
+    if (n < 0) {
+        emit3(x->op, remap(site, d), r, s);
+        return;
+    }
+
+    // a parameter bound to an element, stored after the write
+    opnd_t t;
+    switch (x->op) {
+        case STORE_VAR_OP:
+            emit3(STORE_ARRAY_OP, site->args[n], r, site->idx[n]);
+            return;
+        case WRITE_INT_OP:
+        case WRITE_UINT_OP:
+        case WRITE_CHAR_OP:
+            emit1(x->op, use(site, d));
+            return;
+        case INC_OP:
+        case DEC_OP:
+            t = use(site, d);
+            break;
+        default:
+            t = vregopnd(site->scope, "@inline/elem", d.type);
+            break;
+    }
+    emit3(x->op, t, r, s);
+    emit3(STORE_ARRAY_OP, site->args[n], t, site->idx[n]);
+}
+
+static void copy_body(site_t *site) {
+    ++stampcnt;
+    for (int i = site->callee->beg + 1; i < site->callee->end; ++i) {
+        copy_inst(site, &src[i]);
+    }
+}
+
+////////////////////////////////////////////////////////
+
+// one round over the IR vector, true if a call was inlined
+static bool inline_round(void) {
+    src = insts;
+    srcqty = instqty;
+    scan_functions();
+    loop_depth();
+    siteof = arena_alloc(OPTIM_ARENA, srcqty * sizeof(site_t*));
+    argof = arena_alloc(OPTIM_ARENA, srcqty * sizeof(int));
+    drop = arena_alloc(OPTIM_ARENA, srcqty * sizeof(bool));
+
+    bool any = false;
+    for (int n = 0; n < funqty; ++n) {
+        any |= choose(&funs[n]);
+    }
+    if (!any) {
+        return false;
+    }
+
+    idqty = sidcnt + 1;
+    stamps = arena_alloc(OPTIM_ARENA, idqty * sizeof(int));
+    to = arena_alloc(OPTIM_ARENA, idqty * sizeof(opnd_t));
+    stampcnt = 0;
+
+    ir_detach();
+    for (int n = 0; n < funqty; ++n) {
+        infun_t *f = &funs[n];
+        if (f->calls && f->inlined == f->calls) {
+            dbg("INLINE: drop %s\n", atom_str(f->sym->name));
+            continue;
+        }
+
+        for (int i = f->beg; i <= f->end; ++i) {
+            inst_t *x = &src[i];
+            if (drop[i]) {
+                continue;
+            }
+            if (!siteof[i]) {
+                emit3(x->op, x->d, x->r, x->s);
+            } else if (x->op == CALL_OP) {
+                copy_body(siteof[i]);
+            } else {
+                copy_arg(siteof[i], argof[i], x);
+            }
+        }
+    }
+    free(src);
+    return true;
+}
+
+void inline_optim(void) {
+    if (!inline_limit()) {
+        return;
+    }
+    for (int n = 0; n < INLINE_ROUNDS && inline_round(); ++n) {
+    }
+}
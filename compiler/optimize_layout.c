@@ -0,0 +1,352 @@
+/*
+ * @optimize_layout.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include "common.h"
+#include "optimize.h"
+#include "debug.h"
+#include "ir.h"
+#include "limits.h"
+#include "symtab.h"
+
+// Block layout
+//
+// Jumps through blocks holding only a JUMP (and the labels before it) are
+// threaded to their final target, and the blocks no longer reached are
+// dropped. The blocks left are chained into traces: from the entry, a
+// block is followed by its likelier successor not placed yet, else by the
+// first block left in the original order. The likelier successor of a
+// branch is
+//   - the fall through, when the target is a loop back edge, taken but
+//     placed already
+//   - the successor whose straight run reaches the other one, so an if
+//     with no else falls into its arm and the arm into the join
+//   - the target of a branch on inequality, the fall through otherwise
+// A jump, or a fall through a trampoline, is followed only to a block no
+// block left falls into. The block ends are then rewritten for the new
+// order: a jump to the next block goes, a branch to the next block is
+// inverted and a fall through to another block gets a jump.
+//
+// The pass runs last, pred/succ links are not kept.
+
+// label id => block, for the labels in the IR before the pass
+static bb_t **lab2bb;
+
+// label at the exit of the function, made when a block that falls out of
+// the function is not placed last
+static bb_t *exitbb;
+
+static op_t lastop(bb_t *bb) {
+    return bb->total ? bb->insts[bb->total - 1].op : LABEL_OP;
+}
+
+static bool isbranch(op_t op) {
+    switch (op) {
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// the branch taken when op is not
+static op_t negbranch(op_t op) {
+    switch (op) {
+        case BRANCH_EQU_OP:
+            return BRANCH_NEQ_OP;
+        case BRANCH_NEQ_OP:
+            return BRANCH_EQU_OP;
+        case BRANCH_GTT_OP:
+            return BRANCH_LEQ_OP;
+        case BRANCH_GEQ_OP:
+            return BRANCH_LST_OP;
+        case BRANCH_LST_OP:
+            return BRANCH_GEQ_OP;
+        case BRANCH_LEQ_OP:
+            return BRANCH_GTT_OP;
+        default:
+            unlikely();
+            return op;
+    }
+}
+
+static bool label_only(bb_t *bb) {
+    for (int i = 0; i < bb->total; ++i) {
+        if (bb->insts[i].op != LABEL_OP) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool trampoline(bb_t *bb) {
+    return bb->total == 1 && bb->insts[0].op == JUMP_OP;
+}
+
+// where control entering bb goes first to do some work: through the
+// trampolines and the labels before them. NULL is the exit, bb itself is
+// kept for a cycle of jumps
+static bb_t* resolve(bb_t *bb, int limit) {
+    bb_t *at = bb;
+    for (int n = 0; at && n < limit; ++n) {
+        bb_t *u = at;
+        while (u && label_only(u)) {
+            u = u->next;
+        }
+        if (!u || !trampoline(u)) {
+            return at;
+        }
+        at = lab2bb[u->insts[0].d.id];
+    }
+    return bb;
+}
+
+// straight run from a reaches b, no branch on the way
+static bool runs_into(bb_t *a, bb_t *b, int limit) {
+    for (int n = 0; a && n < limit; ++n) {
+        if (a == b) {
+            return true;
+        }
+        op_t op = lastop(a);
+        if (isbranch(op)) {
+            return false;
+        }
+        a = op == JUMP_OP ? a->take : a->fall;
+    }
+    return false;
+}
+
+// bb falls into the next block, not through a trampoline
+static bool falls_next(bb_t *bb) {
+    return lastop(bb) != JUMP_OP && bb->fall && bb->fall == bb->next;
+}
+
+static bb_t* likelier(bb_t *bb, int limit) {
+    op_t op = lastop(bb);
+    if (op == JUMP_OP) {
+        // a block falling into the target keeps it, as the then arm of an
+        // if with else does the join
+        return bb->take->fallins ? NULL : bb->take;
+    }
+    if (!isbranch(op)) {
+        return falls_next(bb) || !bb->fall || !bb->fall->fallins ? bb->fall : NULL;
+    }
+
+    bb_t *f = bb->fall, *t = bb->take;
+    if (t->placed || t->idx <= bb->idx) {
+        return f;
+    }
+    if (!f || f->placed) {
+        return t;
+    }
+    if (runs_into(f, t, limit)) {
+        return f;
+    }
+    if (runs_into(t, f, limit)) {
+        return t;
+    }
+    return op == BRANCH_NEQ_OP ? t : f;
+}
+
+static void reach(bb_t *bb) {
+    while (bb && !bb->reached) {
+        bb->reached = true;
+        op_t op = lastop(bb);
+        if (op == JUMP_OP) {
+            bb = bb->take;
+            continue;
+        }
+        if (isbranch(op)) {
+            reach(bb->take);
+        }
+        bb = bb->fall;
+    }
+}
+
+// label of bb, a new one goes first in bb when it has none
+static opnd_t label(bb_t *bb) {
+    if (!bb) {
+        bb = exitbb;
+    }
+    if (bb->total && bb->insts[0].op == LABEL_OP) {
+        return bb->insts[0].d;
+    }
+
+    inst_t **v = arena_alloc(OPTIM_ARENA, (bb->total + 1) * sizeof(inst_t*));
+    v[0] = dupinst(LABEL_OP, labelopnd(), NOOPND, NOOPND);
+    for (int i = 0; i < bb->total; ++i) {
+        v[i + 1] = &bb->insts[i];
+    }
+    bbcommit(bb, v, bb->total + 1);
+    return bb->insts[0].d;
+}
+
+// rewrite the end of bb for next, the block placed after it
+static void retarget(bb_t *bb, bb_t *next) {
+    op_t op = lastop(bb);
+    bb_t *t = bb->take, *f = bb->fall;
+    opnd_t tl = NOOPND, fl = NOOPND;
+
+    // the labels first, a new label rewrites its block
+    if (op == JUMP_OP) {
+        if (t != next) {
+            tl = label(t);
+        }
+    } else if (isbranch(op)) {
+        if (t != f) {
+            tl = label(t);
+        }
+        if (f != next) {
+            fl = label(f);
+        }
+    } else if (f != next) {
+        fl = label(f);
+    }
+
+    inst_t **v = arena_alloc(OPTIM_ARENA, (bb->total + 1) * sizeof(inst_t*));
+    int qty = 0;
+    for (int i = 0; i < bb->total; ++i) {
+        v[qty++] = &bb->insts[i];
+    }
+
+    if (op == JUMP_OP) {
+        --qty;
+        if (t != next) {
+            v[qty++] = dupinst(JUMP_OP, tl, NOOPND, NOOPND);
+        }
+    } else if (isbranch(op)) {
+        inst_t *x = v[--qty];
+        if (t == f) {
+            // both ways lead to the same block, no test
+        } else if (f == next) {
+            v[qty++] = dupinst(op, tl, x->r, x->s);
+        } else if (t == next) {
+            v[qty++] = dupinst(negbranch(op), fl, x->r, x->s);
+            fl = NOOPND;
+        } else {
+            v[qty++] = dupinst(op, tl, x->r, x->s);
+        }
+        if (HASOPND(fl)) {
+            v[qty++] = dupinst(JUMP_OP, fl, NOOPND, NOOPND);
+        }
+    } else if (HASOPND(fl)) {
+        v[qty++] = dupinst(JUMP_OP, fl, NOOPND, NOOPND);
+    }
+    bbcommit(bb, v, qty);
+}
+
+static void layout_function(fun_t *fun) {
+    int n = 0, limit;
+    bb_t *bb;
+
+    // empty blocks are fall through only, no label
+    bb_t **link = &fun->bhead;
+    for (bb = fun->bhead; bb; bb = bb->next) {
+        if (bb->total) {
+            bb->idx = n++;
+            *link = bb;
+            link = &bb->next;
+        }
+    }
+    *link = NULL;
+    if (!fun->bhead) {
+        return;
+    }
+    limit = n + 1;
+
+    for (bb = fun->bhead; bb; bb = bb->next) {
+        if (bb->insts[0].op == LABEL_OP) {
+            for (int i = 0; i < bb->total && bb->insts[i].op == LABEL_OP; ++i) {
+                lab2bb[bb->insts[i].d.id] = bb;
+            }
+        }
+    }
+    for (bb = fun->bhead; bb; bb = bb->next) {
+        op_t op = lastop(bb);
+        if (op == JUMP_OP || isbranch(op)) {
+            bb->take = resolve(lab2bb[bb->insts[bb->total - 1].d.id], limit);
+        }
+        if (op != JUMP_OP) {
+            bb->fall = resolve(bb->next, limit);
+        }
+    }
+    reach(fun->bhead);
+    for (bb = fun->bhead; bb; bb = bb->next) {
+        if (bb->reached && falls_next(bb)) {
+            bb->fall->fallins++;
+        }
+    }
+
+    // traces
+    bb_t **order = arena_alloc(OPTIM_ARENA, (n + 1) * sizeof(bb_t*));
+    bb_t *rest = fun->bhead;
+    int qty = 0;
+    bb = fun->bhead;
+    while (bb) {
+        bb->placed = true;
+        order[qty++] = bb;
+        if (falls_next(bb)) {
+            bb->fall->fallins--;
+        }
+
+        bb = likelier(bb, limit);
+        if (!bb || bb->placed || !bb->reached) {
+            while (rest && (rest->placed || !rest->reached)) {
+                rest = rest->next;
+            }
+            bb = rest;
+        }
+    }
+
+    // falling out of the function before the last block goes to exitbb
+    exitbb = NULL;
+    for (int i = 0; i < qty - 1; ++i) {
+        if (lastop(order[i]) != JUMP_OP && !order[i]->fall) {
+            INITMEM(OPTIM_ARENA, bb_t, exitbb);
+            exitbb->fun = fun;
+            inst_t **v = arena_alloc(OPTIM_ARENA, sizeof(inst_t*));
+            v[0] = dupinst(LABEL_OP, labelopnd(), NOOPND, NOOPND);
+            bbcommit(exitbb, v, 1);
+            order[qty++] = exitbb;
+            break;
+        }
+    }
+    for (int i = 0; i < qty; ++i) {
+        if (order[i] != exitbb && lastop(order[i]) != JUMP_OP && !order[i]->fall) {
+            order[i]->fall = exitbb;
+        }
+    }
+
+    for (int i = 0; i < qty; ++i) {
+        retarget(order[i], i + 1 < qty ? order[i + 1] : NULL);
+        order[i]->next = i + 1 < qty ? order[i + 1] : NULL;
+    }
+    fun->bhead = order[0];
+    fun->btail = order[qty - 1];
+}
+
+void layout_optim(void) {
+    lab2bb = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(bb_t*));
+    for (fun_t *fun = mod.fhead; fun; fun = fun->next) {
+        dbg("BLOCK LAYOUT: fun=%s\n", atom_str(fun->scope->nspace));
+        layout_function(fun);
+    }
+}
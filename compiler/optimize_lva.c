@@ -15,15 +15,17 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
+#include <stdlib.h>
+
 #include "ir.h"
 #include "limits.h"
 #include "optimize.h"
 #include "symtab.h"
 #include "util.h"
 
-// test if symbol e is a variable
-bool isvar(syment_t *e) {
-    switch (e->cate) {
+// test if operand o is a variable
+bool isvar(opnd_t *o) {
+    switch (opndcate(o)) {
         case VARIABLE_OBJ:
         case TEMP_OBJ:
         case BY_VALUE_OBJ:
@@ -34,153 +36,190 @@ bool isvar(syment_t *e) {
     }
 }
 
+// number variable o in fun
+static void addvar(fun_t *fun, opnd_t *o) {
+    if (!isvar(o) || fun->varidx[o->id]) {
+        return;
+    }
+    fun->vars = optgrow(fun->vars, fun->total, &fun->varcap, sizeof(opnd_t));
+    fun->vars[fun->total++] = *o;
+    fun->varidx[o->id] = fun->total;
+}
+
+// id to LVA index map, shared by the functions one at a time
+static int *varidx;
+
+// number the variables of fun, sets are as wide as needed for them
+static void collect_vars(fun_t *fun) {
+    fun->varidx = varidx;
+    for (bb_t *bb = fun->bhead; bb; bb = bb->next) {
+        for (int i = 0; i < bb->total; ++i) {
+            addvar(fun, &bb->insts[i].d);
+            addvar(fun, &bb->insts[i].r);
+            addvar(fun, &bb->insts[i].s);
+        }
+    }
+    fun->nwords = BWORDS(fun->total);
+}
+
 // set USE in BB
-void setuse(bb_t *bb, syment_t *e) {
-    if (!isvar(e)) {
+void setuse(bb_t *bb, opnd_t *o) {
+    if (!isvar(o)) {
         return;
     }
-    bb->fun->vars[e->sid] = e;
 
-    // if e belongs to DEF, then skip set USE
-    if (sget(bb->def, e)) {
+    // if o belongs to DEF, then skip set USE
+    if (sget(bb->fun, bb->def, o)) {
         return;
     }
 
-    sset(bb->use, e);
+    sset(bb->fun, bb->use, o);
 
-    dbg("SET USE: %s\n", REPR(e));
+    dbg("SET USE: %s\n", REPR(o));
 }
 
 // set DEF in BB
-void setdef(bb_t *bb, syment_t *e) {
-    if (!isvar(e)) {
+void setdef(bb_t *bb, opnd_t *o) {
+    if (!isvar(o)) {
         return;
     }
-    bb->fun->vars[e->sid] = e;
 
-    // if e belongs to USE, then skip set DEF
-    if (sget(bb->use, e)) {
+    // if o belongs to USE, then skip set DEF
+    if (sget(bb->fun, bb->use, o)) {
         return;
     }
 
-    sset(bb->def, e);
+    sset(bb->fun, bb->def, o);
+
+    dbg("SET DEF: %s\n", REPR(o));
+}
 
-    dbg("SET DEF: %s\n", REPR(e));
+// operands instruction x uses, in use[], and defines, in *def. Returns the
+// number of uses
+static int inst_opnds(inst_t *x, opnd_t *use[2], opnd_t **def) {
+    *def = NULL;
+    switch (x->op) {
+        case ADD_OP:
+        case SUB_OP:
+        case MUL_OP:
+        case DIV_OP:
+        case LOAD_ARRAY_OP:
+            use[0] = &x->r;
+            use[1] = &x->s;
+            *def = &x->d;
+            return 2;
+        case NEG_OP:
+        case STORE_VAR_OP:
+            use[0] = &x->r;
+            *def = &x->d;
+            return 1;
+        case INC_OP:
+        case DEC_OP:
+            use[0] = &x->d;
+            *def = &x->d;
+            return 1;
+        case STORE_ARRAY_OP:
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+        case PUSH_ADDR_OP:
+            use[0] = &x->r;
+            use[1] = &x->s;
+            if (x->op == PUSH_ADDR_OP) {
+                use[1] = &x->d;
+            }
+            return 2;
+        case PUSH_VAL_OP:
+        case WRITE_STRING_OP:
+        case WRITE_INT_OP:
+        case WRITE_UINT_OP:
+        case WRITE_CHAR_OP:
+            use[0] = &x->d;
+            return 1;
+        case CALL_OP:
+        case READ_INT_OP:
+        case READ_UINT_OP:
+        case READ_CHAR_OP:
+            *def = &x->d;
+            return 0;
+        case JUMP_OP:
+        case POP_OP:
+        case FN_START_OP:
+        case FN_END_OP:
+        case LABEL_OP:
+            return 0;
+        default:
+            panic("UNKNOWN_INSTRUCTION_OP");
+    }
+    return 0;
 }
 
 static void calc_use_def(bb_t *bb) {
     dbg("LVA USE/DEF: bb=B%d\n", bb->bid);
 
     // init
-    sclr(bb->use);
-    sclr(bb->def);
-    sclr(bb->in);
-    sclr(bb->out);
+    bb->use = snew(bb->fun);
+    bb->def = snew(bb->fun);
+    bb->in = snew(bb->fun);
+    bb->out = snew(bb->fun);
 
-    int i;
+    opnd_t *use[2], *def;
+    int i, j, n;
     for (i = 0; i < bb->total; ++i) {
-        inst_t *x = bb->insts[i];
-        switch (x->op) {
-            case ADD_OP:
-            case SUB_OP:
-            case MUL_OP:
-            case DIV_OP:
-            case LOAD_ARRAY_OP:
-            case STORE_ARRAY_OP:
-                setuse(bb, x->r);
-                setuse(bb, x->s);
-                setdef(bb, x->d);
-                break;
-            case INC_OP:
-            case DEC_OP:
-                setuse(bb, x->d);
-                break;
-            case NEG_OP:
-            case STORE_VAR_OP:
-                setuse(bb, x->r);
-                setdef(bb, x->d);
-                break;
-            case BRANCH_EQU_OP:
-            case BRANCH_NEQ_OP:
-            case BRANCH_GTT_OP:
-            case BRANCH_GEQ_OP:
-            case BRANCH_LST_OP:
-            case BRANCH_LEQ_OP:
-                setuse(bb, x->r);
-                setuse(bb, x->s);
-                break;
-            case JUMP_OP:
-            case CALL_OP:
-            case FN_START_OP:
-            case FN_END_OP:
-            case LABEL_OP:
-                continue;
-            case PUSH_VAL_OP:
-            case PUSH_ADDR_OP:
-            case POP_OP:
-            case READ_INT_OP:
-            case READ_UINT_OP:
-            case READ_CHAR_OP:
-                setuse(bb, x->d);
-                if (x->r) {
-                    setuse(bb, x->r);
-                }
-                break;
-            case WRITE_STRING_OP:
-            case WRITE_INT_OP:
-            case WRITE_UINT_OP:
-            case WRITE_CHAR_OP:
-                setdef(bb, x->d);
-                break;
-            default:
-                panic("UNKNOWN_INSTRUCTION_OP");
+        n = inst_opnds(&bb->insts[i], use, &def);
+        for (j = 0; j < n; ++j) {
+            setuse(bb, use[j]);
+        }
+        if (def) {
+            setdef(bb, def);
         }
     }
 }
 
 static void dump_vars(fun_t *fun) {
-    int sid;
-    for (sid = 0; sid < MAXSYMENT; ++sid) {
-        syment_t *e = fun->vars[sid];
-        if (!e) {
-            continue;
-        }
-        fun->seqs[fun->total++] = sid;
-        dbg("seq=%02d sid=%02d var=%s\n", fun->total, sid, REPR(e));
+    int i;
+    for (i = 0; i < fun->total; ++i) {
+        dbg("seq=%02d id=%02d var=%s\n", i + 1, fun->vars[i].id, REPR(&fun->vars[i]));
     }
 }
 
-void make_bitmap(fun_t *fun, bits_t bits[], char *bmap) {
-    int i;
-    for (i = 0; i < fun->total; ++i) {
-        bmap[i] = bget(bits, fun->seqs[i]) ? '1' : '0';
+// bitmap of a set, free it after use
+char* make_bitmap(fun_t *fun, bits_t bits[]) {
+    char *bmap = malloc(fun->total + 1);
+    if (bmap == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+    memset(bmap, '0', fun->total);
+    for (int i = bnext(bits, fun->nwords, 0); i >= 0; i = bnext(bits, fun->nwords, i + 1)) {
+        bmap[i] = '1';
     }
     bmap[fun->total] = '\0';
+    return bmap;
 }
 
 void make_vector(fun_t *fun, bits_t bits[], char *vec) {
-    int i;
-    for (i = 0; i < fun->total; ++i) {
-        if (!bget(bits, fun->seqs[i])) {
-            continue;
-        }
+    for (int i = bnext(bits, fun->nwords, 0); i >= 0; i = bnext(bits, fun->nwords, i + 1)) {
         if (strlen(vec) > 0) {
-            strncat(vec, ",", MAXSTRBUF - 1);
+            strncat(vec, ",", MAXSTRBUF - 1 - strlen(vec));
         }
-        strncat(vec, REPR(syments[fun->seqs[i]]), MAXSTRBUF - 1);
+        strncat(vec, REPR(&fun->vars[i]), MAXSTRBUF - 1 - strlen(vec));
     }
 }
 
 static void dump_use_def(fun_t *fun) {
-    //int total = fun->total;
-    //int *seqs = fun->seqs;
+    if (!echo) {
+        return;
+    }
 
     bb_t *bb;
     for (bb = fun->bhead; bb; bb = bb->next) {
-        char bm_def[MAXSYMENT] = { }, bm_use[MAXSYMENT] = { };
-        make_bitmap(fun, bb->def, bm_def);
-        make_bitmap(fun, bb->use, bm_use);
+        char *bm_def = make_bitmap(fun, bb->def), *bm_use = make_bitmap(fun, bb->use);
         dbg("B%d def=%s use=%s\n", bb->bid, bm_def, bm_use);
+        free(bm_def);
+        free(bm_use);
 
         char vt_def[MAXSTRBUF] = { }, vt_use[MAXSTRBUF] = { };
         make_vector(fun, bb->def, vt_def);
@@ -190,13 +229,16 @@ static void dump_use_def(fun_t *fun) {
 }
 
 static void dump_in_out(fun_t *fun) {
-    bb_t *bb;
+    if (!echo) {
+        return;
+    }
 
+    bb_t *bb;
     for (bb = fun->bhead; bb; bb = bb->next) {
-        char bm_in[MAXSYMENT] = { }, bm_out[MAXSYMENT] = { };
-        make_bitmap(fun, bb->in, bm_in);
-        make_bitmap(fun, bb->out, bm_out);
-        dbg("B%d in=%s out=%s\n", bb->bid, bm_in, bm_out);
+        char *bm_in = make_bitmap(fun, bb->in), *bm_out = make_bitmap(fun, bb->out);
+        dbg("B%d in=%s out=%s live in=%d out=%d\n", bb->bid, bm_in, bm_out, bcount(bb->in, fun->nwords), bcount(bb->out, fun->nwords));
+        free(bm_in);
+        free(bm_out);
 
         char vt_in[MAXSTRBUF] = { }, vt_out[MAXSTRBUF] = { };
         make_vector(fun, bb->in, vt_in);
@@ -205,56 +247,108 @@ static void dump_in_out(fun_t *fun) {
     }
 }
 
-// Data Flow Analysis (Backward)
-static void data_flow_anlys(fun_t *fun) {
-    bool changed = true; // flag, loop if IN set is changed
-    int epoch = 1;	     // which iteration round?
+// blocks of fun in postorder of the flow graph, a block comes after all its
+// successors but the loop back edges. Blocks unreachable from the entry
+// follow, each walk in postorder too
+static bb_t** postorder(fun_t *fun, int *qty) {
+    int n = 0;
+    for (bb_t *bb = fun->bhead; bb; bb = bb->next) {
+        n++;
+    }
 
-    while (changed) {
-        dbg("epoch=%d\n", epoch);
-        changed = false;
+    bb_t **order = arena_alloc(OPTIM_ARENA, n * sizeof(bb_t*));
+    bb_t **stack = arena_alloc(OPTIM_ARENA, n * sizeof(bb_t*));
+    int *next = arena_alloc(OPTIM_ARENA, n * sizeof(int));
+    int cnt = 0;
 
-        dump_in_out(fun);
+    for (bb_t *root = fun->bhead; root; root = root->next) {
+        if (root->po) {
+            continue;
+        }
 
-        bb_t *bb;
-        // update IN/OUT in current loop
-        for (bb = fun->bhead; bb; bb = bb->next) {
-            int i;
-            // OUT[B] = Union_{S is B's successor}(IN[S])
-            // sclr(bb->out);
-            for (i = 0; i < MAXBBLINK; ++i) {
-                bb_t *s = bb->succ[i];
-                if (!s) {
-                    break;
+        // walk depth first, next[] is the successor to visit on each level
+        int top = 0;
+        stack[0] = root;
+        next[0] = 0;
+        root->po = -1;
+        while (top >= 0) {
+            bb_t *bb = stack[top];
+            if (next[top] < bb->succcnt) {
+                bb_t *s = bb->succ[next[top]++];
+                if (!s->po) {
+                    s->po = -1;
+                    stack[++top] = s;
+                    next[top] = 0;
                 }
-                sunion(bb->out, bb->out, s->in);
+                continue;
             }
+            order[cnt++] = bb;
+            bb->po = cnt;
+            top--;
+        }
+    }
 
-            // save old IN sets
-            bits_t old_in[NBITARR];
-            sdup(old_in, bb->in);
+    *qty = n;
+    return order;
+}
 
-            // IN[B] = use[B] union (OUT[B] - def[B])
-            bits_t tmp[NBITARR];
-            ssub(tmp, bb->out, bb->def);
-            sunion(bb->in, bb->use, tmp);
+// Data Flow Analysis (Backward)
+//
+// Worklist solver: blocks start queued in postorder, that is reverse
+// postorder of the reversed flow graph, so most of them see the final IN of
+// their successors on the first visit. A block whose IN changes queues its
+// predecessors again.
+static void data_flow_anlys(fun_t *fun) {
+    int visits = 0;
+    int n;
 
-            // check exit condition
-            if (!ssame(bb->in, old_in)) {
-                changed = true;
-            }
+    bb_t **order = postorder(fun, &n);
+
+    // circular queue, a block is on it once at most
+    bb_t **queue = arena_alloc(OPTIM_ARENA, n * sizeof(bb_t*));
+    int head = 0, qty = n;
+    for (int i = 0; i < n; ++i) {
+        queue[i] = order[i];
+        order[i]->queued = true;
+    }
+
+    while (qty > 0) {
+        bb_t *bb = queue[head];
+        head = (head + 1) % n;
+        qty--;
+        bb->queued = false;
+        visits++;
+
+        // OUT[B] = Union_{S is B's successor}(IN[S])
+        sclr(fun, bb->out);
+        for (int i = 0; i < bb->succcnt; ++i) {
+            sunion(fun, bb->out, bb->out, bb->succ[i]->in);
         }
 
-        epoch++;
+        // IN[B] = use[B] union (OUT[B] - def[B])
+        if (!stransfer(fun, bb->in, bb->use, bb->out, bb->def)) {
+            continue;
+        }
+
+        for (int i = 0; i < bb->predcnt; ++i) {
+            bb_t *p = bb->pred[i];
+            if (!p->queued) {
+                p->queued = true;
+                queue[(head + qty++) % n] = p;
+            }
+        }
     }
 
-    dbg("LVA DONE\n");
+    dbg("LVA DONE: blocks=%d visits=%d\n", n, visits);
     dump_in_out(fun);
 }
 
 static void live_var_anlys(fun_t *fun) {
     bb_t *bb;
 
+    // number variables
+    collect_vars(fun);
+
     // init USE/DEF set
     for (bb = fun->bhead; bb; bb = bb->next) {
         calc_use_def(bb);
@@ -268,43 +362,99 @@ static void live_var_anlys(fun_t *fun) {
     data_flow_anlys(fun);
 }
 
-// Eliminate Dead Assign
-static void elim_dead_assign(bb_t *bb) {
-    inst_t *new;
-    int i;
-    for (i = 0; i < bb->total; ++i) {
-        inst_t *curr = bb->insts[i];
+// variables reached from other functions, by id: the ones of an outer scope
+// and the ones passed by reference
+static bool *escaped;
+
+static void find_escaped(void) {
+    for (fun_t *fun = mod.fhead; fun; fun = fun->next) {
+        for (bb_t *bb = fun->bhead; bb; bb = bb->next) {
+            for (int i = 0; i < bb->total; ++i) {
+                inst_t *x = &bb->insts[i];
+                opnd_t *o[3] = { &x->d, &x->r, &x->s };
+                for (int j = 0; j < 3; ++j) {
+                    if (o[j]->kind == SYM_OPND && o[j]->sym->stab != fun->scope) {
+                        escaped[o[j]->id] = true;
+                    }
+                }
+                if (x->op == PUSH_ADDR_OP) {
+                    escaped[x->d.id] = true;
+                }
+            }
+        }
+    }
+}
 
-        // check if eliminate current instruction
-        syment_t *d = curr->d;
-        if (curr->op != STORE_VAR_OP) {
-            goto dupinst;
+// test if a store to d is dead when d is not live after it
+static bool removable(fun_t *fun, opnd_t *d) {
+    switch (opndcate(d)) {
+        case TEMP_OBJ:
+            return true;
+        case VARIABLE_OBJ:
+        case BY_VALUE_OBJ:
+            return d->sym->stab == fun->scope && !escaped[d->id];
+        default:
+            return false;
+    }
+}
+
+// Eliminate Dead Assign, walking back from OUT[B] with the live variables
+static void elim_dead_assign(bb_t *bb) {
+    fun_t *fun = bb->fun;
+    bits_t *live = snew(fun);
+    bool *dead = arena_alloc(OPTIM_ARENA, bb->total * sizeof(bool));
+    opnd_t *use[2], *def;
+    int i, j, n;
+
+    sdup(fun, live, bb->out);
+    for (i = bb->total - 1; i >= 0; --i) {
+        inst_t *x = &bb->insts[i];
+        n = inst_opnds(x, use, &def);
+        bool store = x->op == STORE_VAR_OP || x->op == INC_OP || x->op == DEC_OP;
+        if (store && removable(fun, &x->d) && !sget(fun, live, &x->d)) {
+            dbg("DEAD ASSIGN: B%d #%03d %s\n", bb->bid, x->xid, REPR(&x->d));
+            dead[i] = true;
+            continue;
         }
-        if (d->cate != VARIABLE_OBJ && d->cate != TEMP_OBJ) {
-            goto dupinst;
+
+        if (def && isvar(def)) {
+            sdel(fun, live, def);
         }
-        if (!sget(bb->in, d) && !sget(bb->out, d)) {
-            continue;
+        for (j = 0; j < n; ++j) {
+            if (isvar(use[j])) {
+                sset(fun, live, use[j]);
+            }
         }
+    }
 
-dupinst:
-        new = dupinst(curr->op, curr->d, curr->r, curr->s);
-        if (bb->inst3cnt >= MAXBBINST) {
-            panic("LVA_ELIM_DEAD_ASSIGN_OVERFLOW");
+    for (i = 0; i < bb->total; ++i) {
+        if (!dead[i]) {
+            bb->insts3 = optgrow(bb->insts3, bb->inst3cnt, &bb->inst3cap, sizeof(inst_t*));
+            bb->insts3[bb->inst3cnt++] = &bb->insts[i];
         }
-        bb->insts3[bb->inst3cnt++] = new;
     }
 }
 
 void lva_optim(void) {
     fun_t *fun;
+    bits_select(bits_best());
+    varidx = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(int));
+    escaped = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(bool));
+    find_escaped();
     for (fun = mod.fhead; fun; fun = fun->next) {
-        dbg("LIVE VARIABLE ANALYSIS: fun=%s\n", fun->scope->nspace);
+        dbg("LIVE VARIABLE ANALYSIS: fun=%s\n", atom_str(fun->scope->nspace));
         live_var_anlys(fun);
 
         bb_t *bb;
         for (bb = fun->bhead; bb; bb = bb->next) {
             elim_dead_assign(bb);
+            bbcommit(bb, bb->insts3, bb->inst3cnt);
+        }
+
+        // hand the map clean to the next function
+        for (int i = 0; i < fun->total; ++i) {
+            varidx[fun->vars[i].id] = 0;
         }
+        fun->varidx = NULL;
     }
 }
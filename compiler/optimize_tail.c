@@ -0,0 +1,453 @@
+/*
+ * @optimize_tail.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "optimize.h"
+#include "debug.h"
+#include "global.h"
+#include "ir.h"
+#include "limits.h"
+#include "symtab.h"
+
+// Tail calls
+//
+// A call of a function to itself is a tail call when nothing runs after
+// it but the store of its value as the result and the way to FN_END:
+// labels, jumps and branches. A branch on the way is followed when the
+// branch the call sits under decides it, as in
+//     if i > j then gcd := gcd(i - j, j);
+//     if i < j then gcd := gcd(i, j - i);
+// where i > j holds after the first call and i < j is false. The call
+// becomes the store of the arguments in the parameters and a jump back to
+// the entry, the pushes copy the arguments they take from variables, so a
+// parameter stored first is read as it was.
+//
+// Functions with parameters by reference are left alone, an address
+// can't be stored, and so are those with nested procedures, which see the
+// parameters. Tail calls to other functions stay calls: the VM keeps the
+// arguments under the frame of the caller and the caller drops them, no
+// frame can be reused.
+
+// function of the IR vector
+typedef struct _tlfun_struct {
+    syment_t *sym;
+    int beg;      // FN_START index
+    int end;      // FN_END index
+    int sites;    // tail calls
+    opnd_t entry; // label after FN_START, the tail calls jump to
+} tlfun_t;
+
+// tail call
+typedef struct _tlsite_struct {
+    tlfun_t *fun;
+    opnd_t *args; // value stored in the parameter, by number, or none
+} tlsite_t;
+
+// relation of branch operands r and s known at a line
+typedef struct _fact_struct {
+    opnd_t r;
+    opnd_t s;
+    int holds; // outcomes, as REL_LT | REL_EQ | REL_GT
+} fact_t;
+
+// outcomes of comparing r with s
+#define REL_LT 1
+#define REL_EQ 2
+#define REL_GT 4
+
+// the IR vector of the pass, read while the next one is emitted
+static inst_t *src;
+static int srcqty;
+
+static int *labat; // label id => index
+static int *refs;  // label id => jumps to it
+static int *from;  // label id => index of a jump to it
+
+// per instruction of the IR vector
+static tlsite_t **siteof; // CALL or push of a tail call, its site
+static int *argof;        // push: parameter number
+static bool *drop;        // POP and result store of a tail call
+
+static bool isbranch(op_t op) {
+    switch (op) {
+        case BRANCH_EQU_OP:
+        case BRANCH_NEQ_OP:
+        case BRANCH_GTT_OP:
+        case BRANCH_GEQ_OP:
+        case BRANCH_LST_OP:
+        case BRANCH_LEQ_OP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// outcomes of r and s taking the branch
+static int outcomes(op_t op) {
+    switch (op) {
+        case BRANCH_EQU_OP:
+            return REL_EQ;
+        case BRANCH_NEQ_OP:
+            return REL_LT | REL_GT;
+        case BRANCH_GTT_OP:
+            return REL_GT;
+        case BRANCH_GEQ_OP:
+            return REL_EQ | REL_GT;
+        case BRANCH_LST_OP:
+            return REL_LT;
+        case BRANCH_LEQ_OP:
+            return REL_LT | REL_EQ;
+        default:
+            unlikely();
+            return 0;
+    }
+}
+
+// outcomes m with r and s exchanged
+static int swapped(int m) {
+    return (m & REL_EQ) | (m & REL_LT ? REL_GT : 0) | (m & REL_GT ? REL_LT : 0);
+}
+
+static bool same(opnd_t *a, opnd_t *b) {
+    if (a->kind != b->kind) {
+        return false;
+    }
+    return a->kind == IMM_OPND ? a->imm == b->imm : a->id == b->id;
+}
+
+// instruction x writes o
+static bool writes(inst_t *x, opnd_t *o) {
+    switch (x->op) {
+        case ADD_OP:
+        case SUB_OP:
+        case MUL_OP:
+        case DIV_OP:
+        case INC_OP:
+        case DEC_OP:
+        case NEG_OP:
+        case LOAD_ARRAY_OP:
+        case STORE_VAR_OP:
+        case CALL_OP:
+        case READ_INT_OP:
+        case READ_UINT_OP:
+        case READ_CHAR_OP:
+            return same(&x->d, o);
+        default:
+            return false;
+    }
+}
+
+// the address of o is passed somewhere in f, a call can write it
+static bool addressed(tlfun_t *f, opnd_t *o) {
+    for (int i = f->beg + 1; i < f->end; ++i) {
+        if (src[i].op == PUSH_ADDR_OP && same(&src[i].d, o)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// o keeps its value over a call of the function to itself: a constant, a
+// temporary or a variable of the frame no call writes
+static bool stable(tlfun_t *f, opnd_t *o) {
+    switch (o->kind) {
+        case IMM_OPND:
+        case VREG_OPND:
+            return true;
+        case SYM_OPND:
+            return o->sym->stab == f->sym->scope && (o->sym->cate == VARIABLE_OBJ || o->sym->cate == BY_VALUE_OBJ)
+                    && !addressed(f, o);
+        default:
+            return false;
+    }
+}
+
+// the relation known at line c: the block of c is entered only through
+// one way out of a branch on frame operands, the fall through or the jump
+// to a label nothing else jumps or falls to
+static bool guard(tlfun_t *f, int c, fact_t *fact) {
+    int i;
+    inst_t *b = NULL;
+    for (i = c - 1; i > f->beg && !b; --i) {
+        op_t op = src[i].op;
+        if (isbranch(op)) {
+            b = &src[i];
+            fact->holds = (REL_LT | REL_EQ | REL_GT) & ~outcomes(op);
+        } else if (op == JUMP_OP) {
+            return false;
+        } else if (op == LABEL_OP && refs[src[i].d.id]) {
+            b = &src[from[src[i].d.id]];
+            if (refs[src[i].d.id] != 1 || !isbranch(b->op) || src[i - 1].op != JUMP_OP) {
+                return false;
+            }
+            fact->holds = outcomes(b->op);
+        }
+    }
+    if (!b) {
+        return false;
+    }
+
+    fact->r = b->r;
+    fact->s = b->s;
+    if (!stable(f, &fact->r) || !stable(f, &fact->s)) {
+        return false;
+    }
+    for (i += 2; i < c; ++i) {
+        if (writes(&src[i], &fact->r) || writes(&src[i], &fact->s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the branch x as the fact decides it: 1 taken, 0 not, -1 unknown
+static int decide(fact_t *fact, inst_t *x) {
+    int m;
+    if (same(&x->r, &fact->r) && same(&x->s, &fact->s)) {
+        m = fact->holds;
+    } else if (same(&x->r, &fact->s) && same(&x->s, &fact->r)) {
+        m = swapped(fact->holds);
+    } else {
+        return -1;
+    }
+
+    int taken = outcomes(x->op);
+    if (!(m & ~taken)) {
+        return 1;
+    }
+    if (!(m & taken)) {
+        return 0;
+    }
+    return -1;
+}
+
+// from line p, FN_END is reached running no instruction but the control
+// ones. fact is NULL when nothing is known
+static bool reaches_end(int p, fact_t *fact) {
+    for (int n = 0; n < srcqty; ++n) {
+        inst_t *x = &src[p];
+        if (x->op == FN_END_OP) {
+            return true;
+        }
+        if (x->op == LABEL_OP) {
+            ++p;
+            continue;
+        }
+        if (x->op == JUMP_OP) {
+            p = labat[x->d.id];
+            continue;
+        }
+        if (!isbranch(x->op) || !fact) {
+            return false;
+        }
+        switch (decide(fact, x)) {
+            case 1:
+                p = labat[x->d.id];
+                break;
+            case 0:
+                ++p;
+                break;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+static int params(syment_t *e) {
+    int qty = 0;
+    for (param_t *p = e->phead; p; p = p->next) {
+        ++qty;
+    }
+    return qty;
+}
+
+// functions that can loop on themselves
+static bool loopable(tlfun_t *f) {
+    if (!strcmp(atom_str(f->sym->name), MAINFUNC)) {
+        return false;
+    }
+    for (param_t *p = f->sym->phead; p; p = p->next) {
+        if (p->symbol->cate != BY_VALUE_OBJ) {
+            return false;
+        }
+    }
+    for (syment_t *e = f->sym->scope->ehead; e; e = e->next) {
+        if (e->cate == PROC_OBJ || e->cate == FUNCTION_OBJ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// find the tail calls of function f
+static void find_sites(tlfun_t *f) {
+    int *pushes = arena_alloc(OPTIM_ARENA, (f->end - f->beg) * sizeof(int));
+    int qty = 0;
+
+    for (int i = f->beg + 1; i < f->end; ++i) {
+        inst_t *x = &src[i];
+        if (x->op == PUSH_VAL_OP || x->op == PUSH_ADDR_OP) {
+            pushes[qty++] = i;
+            continue;
+        }
+        if (x->op != CALL_OP) {
+            continue;
+        }
+
+        int args = params(x->r.sym);
+        qty -= args;
+        if (qty < 0) {
+            unlikely();
+        }
+        if (x->r.sym != f->sym) {
+            continue;
+        }
+
+        // the POPs, then the result store
+        int p = i + 1 + args;
+        if (HASOPND(x->d)) {
+            inst_t *y = &src[p];
+            if (y->op != STORE_VAR_OP || y->d.kind != SYM_OPND || y->d.sym != f->sym || !same(&y->r, &x->d)) {
+                continue;
+            }
+            ++p;
+        }
+        fact_t fact;
+        if (!reaches_end(p, guard(f, i, &fact) ? &fact : NULL)) {
+            continue;
+        }
+
+        tlsite_t *site;
+        INITMEM(OPTIM_ARENA, tlsite_t, site);
+        site->fun = f;
+        site->args = arena_alloc(OPTIM_ARENA, (args + 1) * sizeof(opnd_t));
+        siteof[i] = site;
+        // the first argument is pushed last
+        for (int n = 0; n < args; ++n) {
+            siteof[pushes[qty + args - 1 - n]] = site;
+            argof[pushes[qty + args - 1 - n]] = n;
+        }
+        for (int n = i + 1; n < p; ++n) {
+            drop[n] = true;
+        }
+        f->sites++;
+        dbg("TAIL CALL: %s line %d\n", atom_str(f->sym->name), i);
+    }
+}
+
+static syment_t* param(syment_t *e, int pos) {
+    param_t *p = e->phead;
+    for (int n = 0; n < pos; ++n) {
+        p = p->next;
+    }
+    return p->symbol;
+}
+
+// the push x of argument pos: the value the parameter takes, copied when
+// a variable as a store of the parameters can change it first
+static void tail_arg(tlsite_t *site, int pos, inst_t *x) {
+    syment_t *e = param(site->fun->sym, pos);
+    opnd_t v = x->d;
+
+    if (v.kind == SYM_OPND && v.sym == e) {
+        // passed on as it is
+        site->args[pos] = NOOPND;
+        return;
+    }
+    if (v.kind == SYM_OPND) {
+        v = vregopnd(site->fun->sym->scope, "@tail/arg", e->type);
+        emit2(STORE_VAR_OP, v, x->d);
+    }
+    site->args[pos] = v;
+}
+
+// the call: store the parameters, loop
+static void tail_call(tlsite_t *site) {
+    syment_t *f = site->fun->sym;
+    for (int n = 0; n < params(f); ++n) {
+        if (HASOPND(site->args[n])) {
+            emit2(STORE_VAR_OP, symopnd(param(f, n)), site->args[n]);
+        }
+    }
+    emit1(JUMP_OP, site->fun->entry);
+}
+
+void tail_optim(void) {
+    src = insts;
+    srcqty = instqty;
+    labat = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(int));
+    refs = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(int));
+    from = arena_alloc(OPTIM_ARENA, (sidcnt + 1) * sizeof(int));
+    siteof = arena_alloc(OPTIM_ARENA, srcqty * sizeof(tlsite_t*));
+    argof = arena_alloc(OPTIM_ARENA, srcqty * sizeof(int));
+    drop = arena_alloc(OPTIM_ARENA, srcqty * sizeof(bool));
+
+    tlfun_t *funs = arena_alloc(OPTIM_ARENA, (srcqty / 2 + 1) * sizeof(tlfun_t));
+    int funqty = 0;
+    for (int i = 0; i < srcqty; ++i) {
+        inst_t *x = &src[i];
+        if (x->op == LABEL_OP) {
+            labat[x->d.id] = i;
+        } else if (x->op == JUMP_OP || isbranch(x->op)) {
+            refs[x->d.id]++;
+            from[x->d.id] = i;
+        } else if (x->op == FN_START_OP) {
+            funs[funqty].sym = x->d.sym;
+            funs[funqty].beg = i;
+        } else if (x->op == FN_END_OP) {
+            funs[funqty++].end = i;
+        }
+    }
+
+    int sites = 0;
+    for (int n = 0; n < funqty; ++n) {
+        if (loopable(&funs[n])) {
+            find_sites(&funs[n]);
+            sites += funs[n].sites;
+        }
+    }
+    if (!sites) {
+        return;
+    }
+
+    ir_detach();
+    for (int n = 0; n < funqty; ++n) {
+        tlfun_t *f = &funs[n];
+        for (int i = f->beg; i <= f->end; ++i) {
+            inst_t *x = &src[i];
+            if (drop[i]) {
+                continue;
+            }
+            if (!siteof[i]) {
+                emit3(x->op, x->d, x->r, x->s);
+            } else if (x->op == CALL_OP) {
+                tail_call(siteof[i]);
+            } else {
+                tail_arg(siteof[i], argof[i], x);
+            }
+            if (i == f->beg && f->sites) {
+                f->entry = labelopnd();
+                emit1(LABEL_OP, f->entry);
+            }
+        }
+    }
+    free(src);
+}
@@ -16,6 +16,7 @@
  */
 
 #include <stdio.h>
+#include <time.h>
 
 #include "common.h"
 #include "debug.h"
@@ -28,9 +29,6 @@
 #include "lexical.h"
 #include "syntax.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 static pgm_node_t* parse_pgm(void);
 static block_node_t* parse_block(void);
 static const_dec_node_t* parse_const_dec(void);
@@ -58,7 +56,7 @@ static expr_node_t* parse_expr(void);
 static term_node_t* parse_term(void);
 static factor_node_t* parse_factor(void);
 static cond_node_t* parse_cond(void);
-static ident_node_t* parse_ident(idreadmode_t mode);
+static ident_node_t* parse_ident(void);
 static para_list_node_t* parse_para_list(void);
 static para_def_node_t* parse_para_def(void);
 static arg_list_node_t* parse_arg_list(void);
@@ -66,29 +64,48 @@ static arg_list_node_t* parse_arg_list(void);
 // syntax tree
 int nidcnt = 0;
 
-// current token
-static token_t currtok;
-// hold previous token
-static token_t prevtok;
-static char prevtokbuf[MAXTOKSIZE + 1];
-static int prevlineno;
+// token stream and current token index
+static tokstream_t toks;
+static uint32_t tokpos;
+
+// token n ahead of current one
+#define PEEK(n)   ((token_t) toks.kind[tokpos + (n)])
+#define currtok   PEEK(0)
+#define currline  (toks.line[tokpos])
+
+// span of token n ahead of current one
+static tokspan_t tokat(int n) {
+    uint32_t i = tokpos + n;
+    tokspan_t span = { toks.offset[i], toks.length[i], toks.line[i], 0 };
+    return span;
+}
+
+// value of current number token
+static long int currval(void) {
+    tokspan_t span = tokat(0);
+    return tokval(&span);
+}
+
+// current character token
+static char currchar(void) {
+    tokspan_t span = tokat(0);
+    return TOKCHAR(span);
+}
 
 // match an expected token, and skip to next token
 static void match(token_t expected) {
     // check if token matched
     if (currtok != expected) {
         char buf[MAXSTRBUF];
-        sprintf(buf, "UNEXPECTED_TOKEN: LINE%d [%s]", lineno, tokbuf);
+        sprintf(buf, "UNEXPECTED_TOKEN: LINE%d [%.*s]", currline, (int) (toks.length[tokpos] < MAXTOKSIZE ? toks.length[tokpos] : MAXTOKSIZE),
+                srcbuf + toks.offset[tokpos]);
         panic(buf);
     }
 
-    // store previous token
-    strcopy(prevtokbuf, tokbuf);
-    prevtok = currtok;
-    prevlineno = toklineno;
-
-    // read next token
-    currtok = gettok();
+    // next token, ENDFILE is the last one
+    if (currtok != ENDFILE) {
+        ++tokpos;
+    }
 }
 
 /**
@@ -106,7 +123,7 @@ static pgm_node_t* parse_pgm(void) {
     entry->value = 0;
     entry->length = 0;
     entry->line = 0;
-    strcpy(entry->name, MAINFUNC);
+    entry->name = atom_cstr(MAINFUNC);
     t->entry = entry;
 
     t->bp = parse_block();
@@ -172,7 +189,7 @@ static const_def_node_t* parse_const_def(void) {
     NEWNODE(const_def_node_t, t);
 
     if (TOKANY(MC_ID)) {
-        t->idp = parse_ident(READCURR);
+        t->idp = parse_ident();
     }
 
     match(SS_EQU);
@@ -183,24 +200,24 @@ static const_def_node_t* parse_const_def(void) {
                 match(SS_PLUS);
                 t->idp->kind = UINT_CONST_IDENT;
                 t->idp->sign = false;
-                t->idp->value = atol(tokbuf);
+                t->idp->value = currval();
                 match(MC_UNS);
                 break;
             case SS_MINUS:
                 match(SS_MINUS);
                 t->idp->kind = INT_CONST_IDENT;
                 t->idp->sign = true;
-                t->idp->value = atoi(tokbuf);
+                t->idp->value = (int) currval();
                 match(MC_UNS);
                 break;
             case MC_UNS:
                 t->idp->kind = UINT_CONST_IDENT;
-                t->idp->value = atoi(tokbuf);
+                t->idp->value = (int) currval();
                 match(MC_UNS);
                 break;
             case MC_CH:
                 t->idp->kind = CHAR_CONST_IDENT;
-                t->idp->value = (int) tokbuf[0];
+                t->idp->value = (int) currchar();
                 match(MC_CH);
                 break;
             default:
@@ -244,13 +261,13 @@ static var_def_node_t* parse_var_def(void) {
     NEWNODE(var_def_node_t, t);
 
     int arrlen = 0;
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
 
     for (p = t; TOKANY(SS_COMMA); p = q) {
         match(SS_COMMA);
         NEWNODE(var_def_node_t, q);
         p->next = q;
-        q->idp = parse_ident(READCURR);
+        q->idp = parse_ident();
     }
 
     match(SS_COLON);
@@ -278,7 +295,7 @@ static var_def_node_t* parse_var_def(void) {
             match(KW_ARRAY);
             match(SS_LBRA);
             if (TOKANY(MC_UNS)) {
-                arrlen = atoi(tokbuf);
+                arrlen = (int) currval();
                 match(MC_UNS);
             } else {
                 unlikely();
@@ -387,7 +404,7 @@ static proc_head_node_t* parse_proc_head(void) {
     NEWNODE(proc_head_node_t, t);
 
     match(KW_PROCEDURE);
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
     t->idp->kind = PROC_IDENT;
 
     match(SS_LPAR);
@@ -444,7 +461,7 @@ static fun_head_node_t* parse_fun_head(void) {
     NEWNODE(fun_head_node_t, t);
 
     match(KW_FUNCTION);
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
     match(SS_LPAR);
     if (TOKANY2(KW_VAR, MC_ID)) {
         t->plp = parse_para_list();
@@ -508,18 +525,19 @@ static stmt_node_t* parse_stmt(void) {
             t->frp = parse_for_stmt();
             break;
         case MC_ID:
-            match(MC_ID);
-            if (TOKANY(SS_LPAR)) {
+            if (PEEK(1) == SS_LPAR) {
                 t->kind = PCALL_STMT;
                 t->pcp = parse_pcall_stmt();
-            } else if (TOKANY2(SS_ASGN, SS_LBRA)) {
+            } else if (PEEK(1) == SS_ASGN || PEEK(1) == SS_LBRA) {
                 t->kind = ASSGIN_STMT;
                 t->asp = parse_assign_stmt();
-            } else if (TOKANY(SS_EQU)) {
+            } else if (PEEK(1) == SS_EQU) {
+                int line = currline;
                 t->kind = ASSGIN_STMT;
                 t->asp = parse_assign_stmt();
-                rescue(ERRTOK, "L%d: bad token, = may be :=", lineno);
+                rescue(ERRTOK, "L%d: bad token, = may be :=", line);
             } else {
+                match(MC_ID);
                 unlikely();
             }
             break;
@@ -532,9 +550,6 @@ static stmt_node_t* parse_stmt(void) {
 }
 
 /**
- * remember in the statement build function
- * we have read the token from ident to := or '['
- *
  * assignstmt ->
  *	ident := expression | funident := expression
  *		| ident '[' expression ']' := expression
@@ -543,17 +558,16 @@ static assign_stmt_node_t* parse_assign_stmt(void) {
     assign_stmt_node_t *t;
     NEWNODE(assign_stmt_node_t, t);
 
+    t->idp = parse_ident();
     switch (currtok) {
         case SS_ASGN:
             t->kind = NORM_ASSGIN;
-            t->idp = parse_ident(READPREV);
             match(SS_ASGN);
             t->lep = NULL;
             t->rep = parse_expr();
             break;
         case SS_LBRA:
             t->kind = ARRAY_ASSGIN;
-            t->idp = parse_ident(READPREV);
             match(SS_LBRA);
             t->lep = parse_expr();
             match(SS_RBRA);
@@ -562,7 +576,6 @@ static assign_stmt_node_t* parse_assign_stmt(void) {
             break;
         case SS_EQU: // bad case
             t->kind = NORM_ASSGIN;
-            t->idp = parse_ident(READPREV);
             match(SS_EQU);
             t->lep = NULL;
             t->rep = parse_expr();
@@ -622,7 +635,7 @@ static for_stmt_node_t* parse_for_stmt(void) {
     NEWNODE(for_stmt_node_t, t);
 
     match(KW_FOR);
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
     match(SS_ASGN);
 
     t->lep = parse_expr();
@@ -648,9 +661,6 @@ static for_stmt_node_t* parse_for_stmt(void) {
 }
 
 /**
- * remember in the statement build function
- * we have read the token from ident to (
- *
  * pcallstmt ->
  *	ident '(' [arglist] ')'
  */
@@ -658,7 +668,7 @@ static pcall_stmt_node_t* parse_pcall_stmt(void) {
     pcall_stmt_node_t *t;
     NEWNODE(pcall_stmt_node_t, t);
 
-    t->idp = parse_ident(READPREV);
+    t->idp = parse_ident();
     match(SS_LPAR);
 
     if (TOKANY6(MC_ID, MC_CH, SS_PLUS, SS_MINUS, MC_UNS, SS_LPAR)) {
@@ -670,16 +680,13 @@ static pcall_stmt_node_t* parse_pcall_stmt(void) {
 }
 
 /**
- * remember in the factor build function
- * we have read the token from ident to (
- *
  * fcallstmt ->
  *	ident '(' [arglist] ')'
  */
 static fcall_stmt_node_t* parse_fcall_stmt(void) {
     fcall_stmt_node_t *t;
     NEWNODE(fcall_stmt_node_t, t);
-    t->idp = parse_ident(READPREV);
+    t->idp = parse_ident();
     match(SS_LPAR);
 
     if (TOKANY6(MC_ID, MC_CH, SS_PLUS, SS_MINUS, MC_UNS, SS_LPAR)) {
@@ -722,12 +729,12 @@ static read_stmt_node_t* parse_read_stmt(void) {
 
     match(KW_READ);
     match(SS_LPAR);
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
     for (p = t; TOKANY(SS_COMMA); p = q) {
         match(SS_COMMA);
         NEWNODE(read_stmt_node_t, q);
         p->next = q;
-        q->idp = parse_ident(READCURR);
+        q->idp = parse_ident();
     }
     match(SS_RPAR);
 
@@ -747,7 +754,7 @@ static write_stmt_node_t* parse_write_stmt(void) {
     match(SS_LPAR);
     if (TOKANY(MC_STR)) {
         t->type = STR_WRITE;
-        strcopy(t->sp, tokbuf);
+        t->sp = toks.atom[tokpos];
         match(MC_STR);
     } else if (TOKANY6(MC_ID, MC_CH, SS_PLUS, SS_MINUS, MC_UNS, SS_LPAR)) {
         t->type = ID_WRITE;
@@ -864,12 +871,12 @@ static factor_node_t* parse_factor(void) {
     switch (currtok) {
         case MC_UNS:
             t->kind = UNSIGN_FACTOR;
-            t->value = atol(tokbuf);
+            t->value = currval();
             match(MC_UNS);
             break;
         case MC_CH:
             t->kind = CHAR_FACTOR;
-            t->value = (int) tokbuf[0];
+            t->value = (int) currchar();
             match(MC_CH);
             break;
         case SS_LPAR:
@@ -879,19 +886,18 @@ static factor_node_t* parse_factor(void) {
             match(SS_RPAR);
             break;
         case MC_ID:
-            match(MC_ID);
-            if (TOKANY(SS_LBRA)) {
+            if (PEEK(1) == SS_LBRA) {
                 t->kind = ARRAY_FACTOR;
-                t->idp = parse_ident(READPREV);
+                t->idp = parse_ident();
                 match(SS_LBRA);
                 t->ep = parse_expr();
                 match(SS_RBRA);
-            } else if (TOKANY(SS_LPAR)) {
+            } else if (PEEK(1) == SS_LPAR) {
                 t->kind = FUNCALL_FACTOR;
                 t->fcsp = parse_fcall_stmt();
             } else {
                 t->kind = ID_FACTOR;
-                t->idp = parse_ident(READPREV);
+                t->idp = parse_ident();
             }
             break;
         default:
@@ -946,29 +952,17 @@ static cond_node_t* parse_cond(void) {
 /**
  * construct a identifier
  */
-static ident_node_t* parse_ident(idreadmode_t mode) {
+static ident_node_t* parse_ident(void) {
     ident_node_t *t;
     NEWNODE(ident_node_t, t);
 
-    switch (mode) {
-        case READCURR:
-            t->kind = INIT_IDENT;
-            t->value = 0;
-            t->length = 0;
-            t->line = lineno;
-            strcopy(t->name, tokbuf);
-            match(MC_ID);
-            break;
-        case READPREV:
-            t->kind = INIT_IDENT;
-            t->value = 0;
-            t->length = 0;
-            t->line = prevlineno;
-            strcopy(t->name, prevtokbuf);
-            break;
-        default:
-            unlikely();
-    }
+    t->kind = INIT_IDENT;
+    t->value = 0;
+    t->length = 0;
+    t->line = currline;
+    t->name = toks.atom[tokpos];
+    match(MC_ID);
+
     return t;
 }
 
@@ -1006,13 +1000,13 @@ static para_def_node_t* parse_para_def(void) {
         match(KW_VAR);
     }
 
-    t->idp = parse_ident(READCURR);
+    t->idp = parse_ident();
 
     for (p = t; TOKANY(SS_COMMA); p = q) {
         match(SS_COMMA);
         NEWNODE(para_def_node_t, q);
         p->next = q;
-        q->idp = parse_ident(READCURR);
+        q->idp = parse_ident();
     }
     match(SS_COLON);
 
@@ -1066,9 +1060,23 @@ static arg_list_node_t* parse_arg_list(void) {
 }
 
 void parse(pgm_node_t **pgm) {
-    currtok = gettok();
+    struct timespec beg, end;
+
+    scan_open();
+
+    // lexing is a stage of its own, the parser only indexes the stream
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    lexall(&toks);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (PL0E_OPT_VERBOSE) {
+        msg("; lex    %8u tokens in %.3f ms\n", toks.qty, (end.tv_sec - beg.tv_sec) * 1e3 + (end.tv_nsec - beg.tv_nsec) / 1e6);
+    }
+
+    tokpos = 0;
     *pgm = parse_pgm();
     chkerr("parse fail and exit.");
     phase = SEMANTIC;
+    tokstream_free(&toks);
+    scan_close();
     fclose(source);
 }
@@ -15,317 +15,647 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
-#include <ctype.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "global.h"
 #include "lexical.h"
 #include "scan.h"
 
-static int readc(bool peek);
+static int readc(void);
 static void unreadc(void);
-static token_t getkw(char *s);
+static token_t getkw(const char *s, uint32_t len);
+static void dfa_init(void);
 
-char tokbuf[MAXTOKSIZE + 1];
-int toklineno;
+// source buffer
+const char *srcbuf;
+size_t srclen;
+// true if srcbuf is mapped, false if read into memory
+static bool mapped = false;
+// scan position in srcbuf
+static size_t pos = 0;
+// run skipping function for this CPU
+static skipfn_t skip;
+
+tokspan_t tokspan;
+
+// hold file scan postion (line, column)
+int lineno = 1;
+int colmno = 0;
+
+void scan_open(void) {
+    struct stat st;
+    int fd = fileno(source);
+
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        panic("SOURCE_FILE_NOT_REGULAR");
+    }
+    srclen = st.st_size;
+    pos = 0;
+    skip = skip_select(skip_best());
+    dfa_init();
+    lineno = 1;
+    colmno = 0;
+
+    if (srclen == 0) {
+        srcbuf = "";
+        mapped = false;
+        return;
+    }
+
+    void *p = mmap(NULL, srclen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+        srcbuf = p;
+        mapped = true;
+        return;
+    }
+
+    // no mmap, read whole file
+    char *buf = malloc(srclen);
+    if (buf == NULL) {
+        panic("OUT_OF_MEMORY");
+    }
+    if (fread(buf, 1, srclen, source) != srclen) {
+        panic("SOURCE_FILE_READ_FAIL");
+    }
+    srcbuf = buf;
+    mapped = false;
+}
+
+void scan_close(void) {
+    if (mapped) {
+        munmap((void*) srcbuf, srclen);
+    } else if (srclen) {
+        free((void*) srcbuf);
+    }
+    srcbuf = NULL;
+    srclen = 0;
+    mapped = false;
+}
+
+// character class of each byte, CC_OTHER if not given
+static const uint8_t chclass[256] = {
+        ['\t'] = CC_CNTRL,               //
+        ['\n'] = CC_CNTRL,               //
+        ['\v'] = CC_CNTRL,               //
+        ['\f'] = CC_CNTRL,               //
+        ['\r'] = CC_CNTRL,               //
+        [' ']  = CC_SPACE,               //
+        ['!']  = CC_PRINT,               //
+        ['"']  = CC_DQUO,                //
+        ['#' ... '&'] = CC_PRINT,        //
+        ['\''] = CC_SQUO,                //
+        ['(']  = CC_LPAR,                //
+        [')']  = CC_RPAR,                //
+        ['*']  = CC_STAR,                //
+        ['+']  = CC_PLUS,                //
+        [',']  = CC_COMMA,               //
+        ['-']  = CC_MINUS,               //
+        ['.']  = CC_DOT,                 //
+        ['/']  = CC_OVER,                //
+        ['0' ... '9'] = CC_DIGIT,        //
+        [':']  = CC_COLON,               //
+        [';']  = CC_SEMI,                //
+        ['<']  = CC_LST,                 //
+        ['=']  = CC_EQU,                 //
+        ['>']  = CC_GTT,                 //
+        ['?' ... '@'] = CC_PRINT,        //
+        ['A' ... 'Z'] = CC_ALPHA,        //
+        ['[']  = CC_LBRA,                //
+        ['\\'] = CC_PRINT,               //
+        [']']  = CC_RBRA,                //
+        ['^' ... '`'] = CC_PRINT,        //
+        ['a' ... 'z'] = CC_ALPHA,        //
+        ['{']  = CC_LBBR,                //
+        ['|']  = CC_PRINT,               //
+        ['}']  = CC_RBBR,                //
+        ['~']  = CC_PRINT                //
+};
+
+// DFA actions
+#define SAVE   0x01 // character belongs to token
+#define UNREAD 0x02 // character belongs to next token
+#define BADCH  0x04 // unprintable character
+
+typedef struct _dfa_struct {
+    uint8_t next; // next state, DONE accepts tok
+    uint8_t tok;  // accepted token
+    uint8_t act;  // actions
+} dfa_t;
+
+// DFA transitions: dfa[state][class], built by dfa_init()
+static dfa_t dfa[DONE][MAXCLASS];
+
+// every class of state s goes the same way, but those dfa_on() sets
+static void dfa_row(state_t s, uint8_t next, uint8_t tok, uint8_t act) {
+    for (int c = 0; c < MAXCLASS; c++) {
+        dfa[s][c] = (dfa_t) { next, tok, act };
+    }
+}
+
+static void dfa_on(state_t s, chclass_t c, uint8_t next, uint8_t tok, uint8_t act) {
+    dfa[s][c] = (dfa_t) { next, tok, act };
+}
+
+static void dfa_init(void) {
+    dfa_row(START, DONE, ERROR, SAVE);
+    dfa_on(START, CC_SPACE, START, 0, 0);
+    dfa_on(START, CC_CNTRL, START, 0, 0);
+    dfa_on(START, CC_DIGIT, INUNS, 0, SAVE);
+    dfa_on(START, CC_ALPHA, INIDE, 0, SAVE);
+    dfa_on(START, CC_DQUO, INSTR, 0, 0);
+    dfa_on(START, CC_SQUO, INCHA, 0, 0);
+    dfa_on(START, CC_LBBR, INCMT, 0, 0);
+    dfa_on(START, CC_RBBR, DONE, SS_RBBR, SAVE);
+    dfa_on(START, CC_COLON, INCOM, 0, SAVE);
+    dfa_on(START, CC_GTT, INGRE, 0, SAVE);
+    dfa_on(START, CC_LST, INLES, 0, SAVE);
+    dfa_on(START, CC_EQU, DONE, SS_EQU, SAVE);
+    dfa_on(START, CC_DOT, DONE, SS_DOT, SAVE);
+    dfa_on(START, CC_PLUS, DONE, SS_PLUS, SAVE);
+    dfa_on(START, CC_MINUS, DONE, SS_MINUS, SAVE);
+    dfa_on(START, CC_STAR, DONE, SS_STAR, SAVE);
+    dfa_on(START, CC_OVER, DONE, SS_OVER, SAVE);
+    dfa_on(START, CC_COMMA, DONE, SS_COMMA, SAVE);
+    dfa_on(START, CC_SEMI, DONE, SS_SEMI, SAVE);
+    dfa_on(START, CC_LPAR, DONE, SS_LPAR, SAVE);
+    dfa_on(START, CC_RPAR, DONE, SS_RPAR, SAVE);
+    dfa_on(START, CC_LBRA, DONE, SS_LBRA, SAVE);
+    dfa_on(START, CC_RBRA, DONE, SS_RBRA, SAVE);
+    dfa_on(START, CC_EOF, DONE, ENDFILE, 0);
+
+    // in string, only allow printable character
+    dfa_row(INSTR, INSTR, 0, SAVE);
+    dfa_on(INSTR, CC_OTHER, DONE, ERROR, BADCH);
+    dfa_on(INSTR, CC_CNTRL, DONE, ERROR, BADCH);
+    dfa_on(INSTR, CC_EOF, DONE, ERROR, BADCH);
+    dfa_on(INSTR, CC_DQUO, DONE, MC_STR, 0);
+
+    // in unsign number
+    dfa_row(INUNS, DONE, MC_UNS, UNREAD);
+    dfa_on(INUNS, CC_DIGIT, INUNS, 0, SAVE);
+
+    // in identifier
+    dfa_row(INIDE, DONE, MC_ID, UNREAD);
+    dfa_on(INIDE, CC_DIGIT, INIDE, 0, SAVE);
+    dfa_on(INIDE, CC_ALPHA, INIDE, 0, SAVE);
+
+    // in less than
+    dfa_row(INLES, DONE, SS_LST, UNREAD);
+    dfa_on(INLES, CC_EQU, DONE, SS_LEQ, SAVE);
+    dfa_on(INLES, CC_GTT, DONE, SS_NEQ, SAVE);
+
+    // in colon
+    dfa_row(INCOM, DONE, SS_COLON, UNREAD);
+    dfa_on(INCOM, CC_EQU, DONE, SS_ASGN, SAVE);
+
+    // in great than
+    dfa_row(INGRE, DONE, SS_GTT, UNREAD);
+    dfa_on(INGRE, CC_EQU, DONE, SS_GEQ, SAVE);
+
+    // in character
+    dfa_row(INCHA, INCHA, 0, SAVE);
+    dfa_on(INCHA, CC_SQUO, DONE, MC_CH, 0);
+    dfa_on(INCHA, CC_EOF, DONE, ENDFILE, 0);
+
+    // in comment
+    dfa_row(INCMT, INCMT, 0, 0);
+    dfa_on(INCMT, CC_RBBR, START, 0, 0);
+    dfa_on(INCMT, CC_EOF, DONE, ENDFILE, 0);
+}
+
+// runs of characters that keep the state, skipped in bulk
+static const uint8_t dfa_skip[DONE] = {
+        [START] = SKIP_SPACE,   //
+        [INSTR] = SKIP_STRING,  //
+        [INUNS] = SKIP_DIGIT,   //
+        [INIDE] = SKIP_ALNUM,   //
+        [INLES] = NOSKIP,       //
+        [INCOM] = NOSKIP,       //
+        [INGRE] = NOSKIP,       //
+        [INCHA] = NOSKIP,       //
+        [INCMT] = SKIP_COMMENT  //
+};
+
+// extend token span over n characters starting at p, in column
+static inline void save(const char *p, uint32_t n, int column) {
+    if (!tokspan.length) {
+        tokspan.offset = p - srcbuf;
+        tokspan.line = lineno;
+        tokspan.column = column;
+    }
+    tokspan.length += n;
+}
+
+// scalar prefix of a run, longer runs go to skip()
+#define SKIPSCALAR 16
+
+// skip the run of characters that keeps state
+static inline void skiprun(state_t state) {
+    const char *p = srcbuf + pos, *end = srcbuf + srclen, *lastnl = NULL;
+    const char *limit = end - p > SKIPSCALAR ? p + SKIPSCALAR : end;
+    const char *to = p;
+    uint32_t lines = 0;
+
+    // most runs are short, walk them with the transition table
+    while (to < limit && dfa[state][chclass[(unsigned char) *to]].next == state) {
+        if (*to == '\n') {
+            ++lines;
+            lastnl = to;
+        }
+        ++to;
+    }
+    if (to == limit && to < end) {
+        to = skip(dfa_skip[state], to, end, &lines, &lastnl);
+    }
+    if (to == p) {
+        return;
+    }
+
+    if (dfa[state][chclass[(unsigned char) *p]].act & SAVE) {
+        save(p, to - p, colmno + 1);
+    }
+    if (lines) {
+        lineno += lines;
+        colmno = to - lastnl - 1;
+    } else {
+        colmno += to - p;
+    }
+    pos = to - srcbuf;
+}
 
 // get next token
 token_t gettok(void) {
-    // token buffer index
-    int i = 0;
-    // current token
-    token_t curr = 0;
-    // whether save current character to tokbuf[...]
-    bool save;
-
     // the state of our state machine
     state_t state = START;
+    const dfa_t *t;
+
+    tokspan.length = 0;
 
     // the state machine main loop
-    while (state != DONE) {
-        int ch = readc(false);
-        save = true;
-        // state machine
-        switch (state) {
-            case START:
-                if (isspace(ch)) {
-                    save = false;
-                } else if (isdigit(ch)) {
-                    state = INUNS;
-                } else if (ch == '"') {
-                    save = false;
-                    state = INSTR;
-                } else if (ch == '\'') {
-                    save = false;
-                    state = INCHA;
-                } else if (ch == '{') {
-                    save = false;
-                    state = INCMT;
-                } else if (isalpha(ch)) {
-                    state = INIDE;
-                } else if (ch == ':') {
-                    state = INCOM;
-                } else if (ch == '>') {
-                    state = INGRE;
-                } else if (ch == '<') {
-                    state = INLES;
-                } else {
-                    state = DONE;
-                    switch (ch) {
-                        case EOF:
-                            save = false;
-                            curr = ENDFILE;
-                            break;
-                        case '.':
-                            curr = SS_DOT;
-                            break;
-                        case '+':
-                            curr = SS_PLUS;
-                            break;
-                        case '-':
-                            curr = SS_MINUS;
-                            break;
-                        case '*':
-                            curr = SS_STAR;
-                            break;
-                        case '/':
-                            curr = SS_OVER;
-                            break;
-                        case '=':
-                            curr = SS_EQU;
-                            break;
-                        case ',':
-                            curr = SS_COMMA;
-                            break;
-                        case ';':
-                            curr = SS_SEMI;
-                            break;
-                        case '(':
-                            curr = SS_LPAR;
-                            break;
-                        case ')':
-                            curr = SS_RPAR;
-                            break;
-                        case '[':
-                            curr = SS_LBRA;
-                            break;
-                        case ']':
-                            curr = SS_RBRA;
-                            break;
-                        case '{':
-                            curr = SS_LBBR;
-                            break;
-                        case '}':
-                            curr = SS_RBBR;
-                            break;
-                        default:
-                            curr = ERROR;
-                            break;
-                    }
-                }
-                break;
-            case INCMT: // in comment
-                save = false;
-                if (ch == EOF) {
-                    state = DONE;
-                    curr = ENDFILE;
-                } else if (ch == '}') {
-                    state = START;
-                }
-                break;
-            case INSTR: // in string
-                if (ch == '"') {
-                    state = DONE;
-                    save = false;
-                    curr = MC_STR;
-                } else if (isprint(ch)) {
-                    // only allow printable character
-                } else if (!isprint(ch)) {
-                    panic("unprintable character");
-                } else {
-                    state = DONE;
-                    if (ch == EOF) {
-                        save = false;
-                        i = 0;
-                        curr = ENDFILE;
-                    }
-                }
-                break;
-            case INCHA: // in character
-                if (ch == '\'') {
-                    state = DONE;
-                    save = false;
-                    curr = MC_CH;
-                } else if (isdigit(ch) || isalpha(ch)) {
-                    // skip case
-                } else {
-                    if (ch == EOF) {
-                        save = false;
-                        i = 0;
-                        curr = ENDFILE;
-                        state = DONE;
-                    }
-                }
-                break;
-            case INUNS: // in unsign number
-                if (!isdigit(ch)) {
-                    unreadc();
-                    save = false;
-                    state = DONE;
-                    curr = MC_UNS;
-                }
-                break;
-            case INIDE: // in identifier
-                if (!(isdigit(ch) || isalpha(ch))) {
-                    unreadc();
-                    save = false;
-                    state = DONE;
-                    curr = MC_ID;
-                }
-                break;
-            case INLES: // in less than
-                state = DONE;
-                if (ch == '=') {
-                    curr = SS_LEQ;
-                } else if (ch == '>') {
-                    curr = SS_NEQ;
-                } else {
-                    unreadc();
-                    save = false;
-                    curr = SS_LST;
-                }
-                break;
-            case INCOM: // in comma
-                state = DONE;
-                if (ch == '=') {
-                    curr = SS_ASGN;
-                } else {
-                    unreadc();
-                    save = false;
-                    curr = SS_COLON;
-                }
-                break;
-            case INGRE: // in great than
-                state = DONE;
-                if (ch == '=') {
-                    curr = SS_GEQ;
-                } else {
-                    unreadc();
-                    save = false;
-                    curr = SS_GTT;
-                }
-                break;
-            case DONE:
-            default:
-                dbg("error state = %d", state);
-                state = DONE;
-                curr = ERROR;
-                break;
+    for (;;) {
+        if (dfa_skip[state] != NOSKIP && pos < srclen) {
+            skiprun(state);
         }
 
-        // save ch to tokbuf[...]
-        if ((save) && (i <= MAXTOKSIZE)) {
-            tokbuf[i++] = (char) ch;
-            tokbuf[i] = '\0';
-        } else if (i > MAXTOKSIZE) {
-            dbg("token size is too long, lineno = %d\n", lineno);
+        int ch = readc();
+        t = &dfa[state][ch == EOF ? CC_EOF : chclass[ch]];
+        if (t->act & SAVE) {
+            save(srcbuf + pos - 1, 1, colmno);
         }
-
-        // post-processing works
-        if (state == DONE) {
-            tokbuf[i] = '\0';
-            toklineno = lineno;
-            if (curr == MC_ID) {
-                curr = getkw(tokbuf);
-            }
+        if (t->act & UNREAD) {
+            unreadc();
+        }
+        if (t->act & BADCH) {
+            panic("unprintable character");
+        }
+        if (t->next == DONE) {
+            break;
         }
+        state = t->next;
+    }
+
+    token_t curr = t->tok;
+    if (curr == MC_ID) {
+        curr = getkw(TOKSTR(tokspan), tokspan.length);
     }
 
-    dbg("token=%2d, buf=[%s], pos=%d:%d\n", curr, tokbuf, lineno, colmno);
+    dbg("token=%2d, buf=[%.*s], pos=%d:%d\n", curr, (int) tokspan.length, TOKSTR(tokspan), lineno, colmno);
     return curr;
 }
 
-// Source Code Line Buffer
-char linebuf[MAXLINEBUF];
-int bufsize = 0;
-// when meet EOF, then set done to true
-static bool fileend = false;
-
-// hold file scan postion (line, column)
-int lineno = 0;
-int colmno = 0;
-
 // read a character
-static int readc(bool peek) {
-    if (colmno < bufsize) {
-        goto ready;
-    }
-
-    lineno++;
-    if (fgets(linebuf, MAXLINEBUF - 1, source) == NULL) {
-        fileend = true;
+static int readc(void) {
+    if (pos >= srclen) {
+        ++pos; // unreadc() steps back over EOF too
         return EOF;
     }
-    dbg("source L%03d: %s", lineno, linebuf);
 
-    bufsize = strlen(linebuf);
-    colmno = 0;
-    goto ready;
-
-ready:
-    return (peek) ? linebuf[colmno] : linebuf[colmno++];
+    int ch = (unsigned char) srcbuf[pos++];
+    if (ch == '\n') {
+        lineno++;
+        colmno = 0;
+    } else {
+        colmno++;
+    }
+    return ch;
 }
 
 // unread a charachter
 static void unreadc(void) {
-    if (colmno <= 0) {
-        panic("unread at line postion zero!");
+    if (pos == 0) {
+        panic("unread at source postion zero!");
     }
-    if (!fileend) {
-        colmno--;
+    if (--pos < srclen) {
+        if (srcbuf[pos] == '\n') {
+            lineno--;
+        } else {
+            colmno--;
+        }
     }
 }
 
+int tokcopy(char *d, tokspan_t *span) {
+    int len = span->length < MAXSTRLEN - 1 ? span->length : MAXSTRLEN - 1;
+    memcpy(d, TOKSTR(*span), len);
+    d[len] = '\0';
+    return len;
+}
+
+long int tokval(tokspan_t *span) {
+    const char *s = TOKSTR(*span);
+    long int v = 0;
+    for (uint32_t i = 0; i < span->length; i++) {
+        v = v * 10 + (s[i] - '0');
+    }
+    return v;
+}
+
+// append a token to ts, growing it geometrically
+static void tokpush(tokstream_t *ts, token_t kind, tokspan_t *span) {
+    if (ts->qty == ts->cap) {
+        ts->cap = ts->cap ? ts->cap * 2 : 4096;
+        ts->kind = realloc(ts->kind, ts->cap * sizeof(uint8_t));
+        ts->offset = realloc(ts->offset, ts->cap * sizeof(uint32_t));
+        ts->length = realloc(ts->length, ts->cap * sizeof(uint32_t));
+        ts->line = realloc(ts->line, ts->cap * sizeof(uint32_t));
+        ts->atom = realloc(ts->atom, ts->cap * sizeof(atom_t));
+        if (!ts->kind || !ts->offset || !ts->length || !ts->line || !ts->atom) {
+            panic("OUT_OF_MEMORY");
+        }
+    }
+    ts->kind[ts->qty] = (uint8_t) kind;
+    ts->offset[ts->qty] = span->offset;
+    ts->length[ts->qty] = span->length;
+    ts->line[ts->qty] = span->line;
+
+    // names and strings are hashed here once, as tokcopy() they keep
+    // MAXSTRLEN - 1 characters
+    if (kind == MC_ID || kind == MC_STR) {
+        ts->atom[ts->qty] = atom_intern(TOKSTR(*span), span->length < MAXSTRLEN - 1 ? span->length : MAXSTRLEN - 1);
+    } else {
+        ts->atom[ts->qty] = NOATOM;
+    }
+    ++ts->qty;
+}
+
+void lexall(tokstream_t *ts) {
+    token_t tok;
+
+    memset(ts, 0, sizeof(tokstream_t));
+    do {
+        tok = gettok();
+        tokpush(ts, tok, &tokspan);
+    } while (tok != ENDFILE);
+
+    // second ENDFILE, so PEEK(1) past the last token stays in bounds
+    tokpush(ts, ENDFILE, &tokspan);
+    --ts->qty;
+}
+
+void tokstream_free(tokstream_t *ts) {
+    free(ts->kind);
+    free(ts->offset);
+    free(ts->length);
+    free(ts->line);
+    free(ts->atom);
+    memset(ts, 0, sizeof(tokstream_t));
+}
+
 // Reserved Keyword Table
-static struct _pl0e_keywords_struct {
+//
+// Perfect hash of the fixed keyword set (gperf style):
+//     hash = length + asso[first char] + asso[last char]
+// asso values were searched offline so that every keyword gets its own
+// slot. They are stored plus one, 0 marks characters no keyword starts or
+// ends with. Build with ENABLE_KEYWORD_NOCASE for case-insensitive keywords.
+#define MAXKWHASH 37
+#define MINKWLEN  2
+#define MAXKWLEN  9
+
+static const uint8_t PL0E_KWASSO[256] = {
+#ifdef ENABLE_KEYWORD_NOCASE
+        ['a'] =  6, ['A'] =  6, //
+        ['b'] =  1, ['B'] =  1, //
+        ['c'] =  2, ['C'] =  2, //
+        ['d'] = 15, ['D'] = 15, //
+        ['e'] = 15, ['E'] = 15, //
+        ['f'] =  7, ['F'] =  7, //
+        ['i'] =  8, ['I'] =  8, //
+        ['l'] = 16, ['L'] = 16, //
+        ['n'] =  6, ['N'] =  6, //
+        ['o'] =  2, ['O'] =  2, //
+        ['p'] = 13, ['P'] = 13, //
+        ['r'] = 10, ['R'] = 10, //
+        ['t'] = 20, ['T'] = 20, //
+        ['u'] = 17, ['U'] = 17, //
+        ['v'] = 19, ['V'] = 19, //
+        ['w'] =  6, ['W'] =  6, //
+        ['y'] =  3, ['Y'] =  3, //
+#else
+        ['a'] =  6, //
+        ['b'] =  1, //
+        ['c'] =  2, //
+        ['d'] = 15, //
+        ['e'] = 15, //
+        ['f'] =  7, //
+        ['i'] =  8, //
+        ['l'] = 16, //
+        ['n'] =  6, //
+        ['o'] =  2, //
+        ['p'] = 13, //
+        ['r'] = 10, //
+        ['t'] = 20, //
+        ['u'] = 17, //
+        ['v'] = 19, //
+        ['w'] =  6, //
+        ['y'] =  3, //
+#endif
+};
+
+static const struct _pl0e_keywords_struct {
     // keyword string
     char *str;
+    // keyword length
+    uint32_t len;
     // represented token
     token_t tok;
-} PL0E_KEYWORDS[] = {
-        { "array",     KW_ARRAY     }, //
-        { "begin",     KW_BEGIN     }, //
-        { "char",      KW_CHAR      }, //
-        { "const",     KW_CONST     }, //
-        { "do",        KW_DO        }, //
-        { "downto",    KW_DOWNTO    }, //
-        { "else",      KW_ELSE      }, //
-        { "end",       KW_END       }, //
-        { "for",       KW_FOR       }, //
-        { "function",  KW_FUNCTION  }, //
-        { "if",        KW_IF        }, //
-        { "integer",   KW_INTEGER   }, //
-        { "uinteger",  KW_UINTEGER  }, //
-        { "of",        KW_OF        }, //
-        { "procedure", KW_PROCEDURE }, //
-        { "read",      KW_READ      }, //
-        { "repeat",    KW_REPEAT    }, //
-        { "then",      KW_THEN      }, //
-        { "to",        KW_TO        }, //
-        { "until",     KW_UNTIL     }, //
-        { "var",       KW_VAR       }, //
-        { "write",     KW_WRITE     }  //
+} PL0E_KEYWORDS[MAXKWHASH] = {
+        [ 9] = { "of",        2, KW_OF        }, //
+        [10] = { "begin",     5, KW_BEGIN     }, //
+        [12] = { "array",     5, KW_ARRAY     }, //
+        [14] = { "char",      4, KW_CHAR      }, //
+        [15] = { "if",        2, KW_IF        }, //
+        [17] = { "do",        2, KW_DO        }, //
+        [18] = { "for",       3, KW_FOR       }, //
+        [19] = { "function",  8, KW_FUNCTION  }, //
+        [21] = { "downto",    6, KW_DOWNTO    }, //
+        [22] = { "to",        2, KW_TO        }, //
+        [23] = { "integer",   7, KW_INTEGER   }, //
+        [24] = { "write",     5, KW_WRITE     }, //
+        [25] = { "const",     5, KW_CONST     }, //
+        [27] = { "read",      4, KW_READ      }, //
+        [28] = { "then",      4, KW_THEN      }, //
+        [30] = { "var",       3, KW_VAR       }, //
+        [31] = { "end",       3, KW_END       }, //
+        [32] = { "else",      4, KW_ELSE      }, //
+        [33] = { "uinteger",  8, KW_UINTEGER  }, //
+        [34] = { "repeat",    6, KW_REPEAT    }, //
+        [35] = { "procedure", 9, KW_PROCEDURE }, //
+        [36] = { "until",     5, KW_UNTIL     }, //
 };
 
-#define MAXRESERVED (sizeof(PL0E_KEYWORDS) / sizeof(PL0E_KEYWORDS[0]))
-
 // get keyword
 // if s is keyword return token, otherwise return MC_ID
-static token_t getkw(char *s) {
-    int i;
-    for (i = 0; i < MAXRESERVED; i++) {
-        if (!strcmp(s, PL0E_KEYWORDS[i].str)) {
-            return PL0E_KEYWORDS[i].tok;
+static token_t getkw(const char *s, uint32_t len) {
+    if (len < MINKWLEN || len > MAXKWLEN) {
+        return MC_ID;
+    }
+
+    uint8_t a = PL0E_KWASSO[(unsigned char) s[0]];
+    uint8_t b = PL0E_KWASSO[(unsigned char) s[len - 1]];
+    if (!a || !b) {
+        return MC_ID;
+    }
+
+    uint32_t h = len + a + b - 2;
+    if (h >= MAXKWHASH || PL0E_KEYWORDS[h].len != len) {
+        return MC_ID;
+    }
+
+#ifdef ENABLE_KEYWORD_NOCASE
+    if (strncasecmp(s, PL0E_KEYWORDS[h].str, len)) {
+#else
+    if (memcmp(s, PL0E_KEYWORDS[h].str, len)) {
+#endif
+        return MC_ID;
+    }
+    return PL0E_KEYWORDS[h].tok;
+}
+
+// the keyword list and lookup the perfect hash replaced, the baseline of
+// lexbench()
+static const struct _pl0e_keywords_struct PL0E_KEYWORDS_LINEAR[] = {
+        { "array",     5, KW_ARRAY     }, //
+        { "begin",     5, KW_BEGIN     }, //
+        { "char",      4, KW_CHAR      }, //
+        { "const",     5, KW_CONST     }, //
+        { "do",        2, KW_DO        }, //
+        { "downto",    6, KW_DOWNTO    }, //
+        { "else",      4, KW_ELSE      }, //
+        { "end",       3, KW_END       }, //
+        { "for",       3, KW_FOR       }, //
+        { "function",  8, KW_FUNCTION  }, //
+        { "if",        2, KW_IF        }, //
+        { "integer",   7, KW_INTEGER   }, //
+        { "uinteger",  8, KW_UINTEGER  }, //
+        { "of",        2, KW_OF        }, //
+        { "procedure", 9, KW_PROCEDURE }, //
+        { "read",      4, KW_READ      }, //
+        { "repeat",    6, KW_REPEAT    }, //
+        { "then",      4, KW_THEN      }, //
+        { "to",        2, KW_TO        }, //
+        { "until",     5, KW_UNTIL     }, //
+        { "var",       3, KW_VAR       }, //
+        { "write",     5, KW_WRITE     }  //
+};
+
+static token_t getkw_linear(const char *s, uint32_t len) {
+    for (size_t i = 0; i < sizeof(PL0E_KEYWORDS_LINEAR) / sizeof(PL0E_KEYWORDS_LINEAR[0]); i++) {
+        const char *kw = PL0E_KEYWORDS_LINEAR[i].str;
+        if (kw[0] == s[0] && !strncmp(s, kw, len) && kw[len] == '\0') {
+            return PL0E_KEYWORDS_LINEAR[i].tok;
         }
     }
     return MC_ID;
 }
+
+static double elapsed(struct timespec *beg) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - beg->tv_sec) + (end.tv_nsec - beg->tv_nsec) / 1e9;
+}
+
+void lexbench(void) {
+    static const char *isa_names[] = { "scalar", "sse2", "avx2" };
+    struct timespec beg;
+    long int tokens = 0;
+    token_t tok;
+
+    // words: identifiers and keywords, for the keyword lookup cost
+    tokspan_t *words = NULL;
+    long int words_qty = 0, words_cap = 0;
+
+    // every instruction set this CPU runs, the best one last
+    for (skipisa_t isa = SKIP_SCALAR; isa <= skip_best(); isa++) {
+        skip = skip_select(isa);
+        pos = 0;
+        lineno = 1;
+        colmno = 0;
+        tokens = 0;
+        words_qty = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &beg);
+        while ((tok = gettok()) != ENDFILE) {
+            ++tokens;
+            if (tok == MC_ID || (tok >= KW_ARRAY && tok <= KW_WRITE)) {
+                if (words_qty == words_cap) {
+                    words_cap = words_cap ? words_cap * 2 : 1024;
+                    words = realloc(words, words_cap * sizeof(tokspan_t));
+                    if (words == NULL) {
+                        panic("OUT_OF_MEMORY");
+                    }
+                }
+                words[words_qty++] = tokspan;
+            }
+        }
+        double secs = elapsed(&beg);
+        double mb = srclen / (1024.0 * 1024.0);
+        printf("; lex %-6s %ld tokens, %d lines, %.2f MB in %.3f ms, %.1f MB/s\n", isa_names[isa], tokens, lineno, mb, secs * 1e3,
+                secs > 0 ? mb / secs : 0);
+    }
+
+    // whole input into the token stream the parser reads
+    tokstream_t ts;
+    pos = 0;
+    lineno = 1;
+    colmno = 0;
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    lexall(&ts);
+    double secs = elapsed(&beg);
+    printf("; lex stream %u tokens, %u atoms in %.3f ms, %.1f Mtokens/s, %zu bytes\n", ts.qty, atom_qty(), secs * 1e3,
+            secs > 0 ? ts.qty / secs / 1e6 : 0, (size_t) ts.cap * (sizeof(uint8_t) + 3 * sizeof(uint32_t) + sizeof(atom_t)));
+    tokstream_free(&ts);
+    atom_free();
+
+    if (!words_qty) {
+        free(words);
+        return;
+    }
+
+    // sum the tokens so lookups can't be optimized away
+    volatile long int sink = 0;
+    long int sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (long int n = 0; n < words_qty; n++) {
+        sum += getkw_linear(TOKSTR(words[n]), words[n].length);
+    }
+    double linear = elapsed(&beg);
+    sink += sum;
+
+    sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (long int n = 0; n < words_qty; n++) {
+        sum += getkw(TOKSTR(words[n]), words[n].length);
+    }
+    double hashed = elapsed(&beg);
+    sink += sum;
+
+    printf("; keyword lookup %ld words, keyword list %.2f ns/word, perfect hash %.2f ns/word\n", words_qty, linear * 1e9 / words_qty,
+            hashed * 1e9 / words_qty);
+    free(words);
+}
@@ -0,0 +1,171 @@
+/*
+ * @scan_simd.c
+ *
+ * @brief Pascal for Stack VM
+ * @details
+ * This is based on other projects:
+ *   Compiler for PL/0 plus language: https://github.com/Jeanhwea/Compiler
+ *   Others (see individual files)
+ *
+ *   please contact their authors for more information.
+ *
+ * @author Emiliano Augusto Gonzalez (egonzalez . hiperion @ gmail . com)
+ * @date 2024
+ * @copyright MIT License
+ * @see https://github.com/hiperiondev/stack_vm_pascal
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SKIP_X86
+#endif
+
+// byte belongs to run kind
+static inline bool inrun(skip_t kind, unsigned char ch) {
+    switch (kind) {
+        case SKIP_SPACE:
+            return ch == ' ' || (ch >= '\t' && ch <= '\r');
+        case SKIP_COMMENT:
+            return ch != '}';
+        case SKIP_STRING:
+            return ch != '"' && ch >= 0x20 && ch < 0x7f;
+        case SKIP_DIGIT:
+            return ch >= '0' && ch <= '9';
+        case SKIP_ALNUM:
+            return (ch >= '0' && ch <= '9') || ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z');
+        default:
+            return false;
+    }
+}
+
+static const char* skip_scalar(skip_t kind, const char *p, const char *end, uint32_t *lines, const char **lastnl) {
+    for (; p < end && inrun(kind, *p); p++) {
+        if (*p == '\n') {
+            ++*lines;
+            *lastnl = p;
+        }
+    }
+    return p;
+}
+
+#ifdef SKIP_X86
+
+// count newlines of mask nl, bit n is byte p[n]
+static inline void count_lines(uint32_t nl, const char *p, uint32_t *lines, const char **lastnl) {
+    if (nl) {
+        *lines += __builtin_popcount(nl);
+        *lastnl = p + 31 - __builtin_clz(nl);
+    }
+}
+
+// bytes of x in [lo, lo + span], unsigned compare through min
+#define SSE2_RANGE(x, lo, span) \
+		_mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(x, _mm_set1_epi8(lo)), _mm_set1_epi8(span)), _mm_sub_epi8(x, _mm_set1_epi8(lo)))
+
+__attribute__((target("sse2")))
+static const char* skip_sse2(skip_t kind, const char *p, const char *end, uint32_t *lines, const char **lastnl) {
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; p + 16 <= end; p += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*) p);
+        uint32_t in;
+
+        switch (kind) {
+            case SKIP_SPACE:
+                in = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), SSE2_RANGE(x, '\t', '\r' - '\t')));
+                break;
+            case SKIP_COMMENT:
+                in = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('}'))) & 0xffff;
+                break;
+            case SKIP_STRING:
+                in = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), SSE2_RANGE(x, 0x20, 0x7e - 0x20)));
+                break;
+            case SKIP_DIGIT:
+                in = _mm_movemask_epi8(SSE2_RANGE(x, '0', 9));
+                break;
+            default:
+                return skip_scalar(kind, p, end, lines, lastnl);
+        }
+
+        uint32_t nl = _mm_movemask_epi8(_mm_cmpeq_epi8(x, newline));
+        if (in != 0xffff) {
+            uint32_t stop = ~in & 0xffff;
+            count_lines(nl & ((stop & -stop) - 1), p, lines, lastnl);
+            return p + __builtin_ctz(stop);
+        }
+        count_lines(nl, p, lines, lastnl);
+    }
+    return skip_scalar(kind, p, end, lines, lastnl);
+}
+
+#define AVX2_RANGE(x, lo, span) \
+		_mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(x, _mm256_set1_epi8(lo)), _mm256_set1_epi8(span)), _mm256_sub_epi8(x, _mm256_set1_epi8(lo)))
+
+__attribute__((target("avx2")))
+static const char* skip_avx2(skip_t kind, const char *p, const char *end, uint32_t *lines, const char **lastnl) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    for (; p + 32 <= end; p += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        uint32_t in;
+
+        switch (kind) {
+            case SKIP_SPACE:
+                in = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), AVX2_RANGE(x, '\t', '\r' - '\t')));
+                break;
+            case SKIP_COMMENT:
+                in = ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('}')));
+                break;
+            case SKIP_STRING:
+                in = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')), AVX2_RANGE(x, 0x20, 0x7e - 0x20)));
+                break;
+            case SKIP_DIGIT:
+                in = _mm256_movemask_epi8(AVX2_RANGE(x, '0', 9));
+                break;
+            default:
+                return skip_scalar(kind, p, end, lines, lastnl);
+        }
+
+        uint32_t nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, newline));
+        if (in != 0xffffffff) {
+            uint32_t stop = ~in;
+            count_lines(nl & ((stop & -stop) - 1), p, lines, lastnl);
+            return p + __builtin_ctz(stop);
+        }
+        count_lines(nl, p, lines, lastnl);
+    }
+    return skip_sse2(kind, p, end, lines, lastnl);
+}
+
+#endif
+
+skipisa_t skip_best(void) {
+#ifdef SKIP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SKIP_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SKIP_SSE2;
+    }
+#endif
+    return SKIP_SCALAR;
+}
+
+skipfn_t skip_select(skipisa_t isa) {
+    switch (isa) {
+#ifdef SKIP_X86
+        case SKIP_AVX2:
+            return skip_avx2;
+        case SKIP_SSE2:
+            return skip_sse2;
+#endif
+        default:
+            return skip_scalar;
+    }
+}
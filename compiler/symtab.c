@@ -15,6 +15,10 @@
  * @see https://github.com/hiperiondev/stack_vm_pascal
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 #include "global.h"
 #include "debug.h"
 #include "limits.h"
@@ -23,23 +27,48 @@
 #include "syntax.h"
 #include "symtab.h"
 
-extern void **memtrack;
-extern unsigned long memtrack_qty;
-
 // symbol table management
 symtab_t *top = NULL;
 int depth = 0;
 int tidcnt = 0;
 
-syment_t *syments[MAXSYMENT];
 int sidcnt = 0;
 
-symtab_t* scope_entry(char *nspace) {
+// label prefix by category
+static const char *labelpfx[] = {
+    [NOP_OBJ] = "CNS",
+    [CONSTANT_OBJ] = "CNS",
+    [VARIABLE_OBJ] = "VBL",
+    [PROC_OBJ] = "FUN",
+    [FUNCTION_OBJ] = "FUN",
+    [ARRAY_OBJ] = "ARR",
+    [BY_VALUE_OBJ] = "VAL",
+    [BY_REFERENCE_OBJ] = "VAL",
+    [TEMP_OBJ] = "TMP",
+    [LABEL_OBJ] = "LBL",
+    [NUMBER_OBJ] = "LIT",
+    [STRING_OBJ] = "TMP",
+};
+
+const char* mklabel(cate_t cate, int id) {
+    static char ring[LABELRING][16];
+    static int next = 0;
+
+    char *buf = ring[next++ % LABELRING];
+    snprintf(buf, sizeof(ring[0]), "%s%03d", labelpfx[cate], id);
+    return buf;
+}
+
+const char* symlabel(syment_t *e) {
+    return mklabel(e->cate, e->sid);
+}
+
+symtab_t* scope_entry(atom_t nspace) {
     symtab_t *t;
     NEWSTAB(t);
     t->tid = ++tidcnt;
     t->depth = ++depth;
-    strcopy(t->nspace, nspace);
+    t->nspace = nspace;
     t->varoff = 1; // reserve function return value
 
     // Push
@@ -50,7 +79,7 @@ symtab_t* scope_entry(char *nspace) {
     top = t;
 
     // trace log
-    dbg("push depth=%d tid=%d nspace=%s\n", t->depth, t->tid, t->nspace);
+    dbg("push depth=%d tid=%d nspace=%s\n", t->depth, t->tid, atom_str(t->nspace));
     return t;
 }
 
@@ -68,14 +97,9 @@ symtab_t* scope_exit(void) {
     // trace log
     //   1. dump table info
     //   2. dump all table entry
-    dbg("pop depth=%d tid=%d nspace=%s\n", t->depth, t->tid, t->nspace);
-    int i;
-    for (i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &t->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            dbg("sid=%d, name=%s\n", e->sid, e->name);
-        }
+    dbg("pop depth=%d tid=%d nspace=%s\n", t->depth, t->tid, atom_str(t->nspace));
+    for (syment_t *e = t->ehead; e; e = e->next) {
+        dbg("sid=%d, name=%s\n", e->sid, atom_str(e->name));
     }
     return t;
 }
@@ -86,45 +110,98 @@ symtab_t* scope_top(void) {
 }
 
 // entry management
-const int HASHSIZE = 211;
-const int HASHSHIFT = 4;
+//
+// Names are atoms, the slot hash is a bijective mix of the atom (murmur3
+// finalizer), so equal hashes mean equal names and probing never touches
+// the entries. Collisions are resolved Robin Hood style: an entry takes the
+// slot of any entry closer to its home slot, which keeps probe sequences
+// short and lets a miss stop at the first entry closer to home than itself.
+static inline uint32_t symhash(atom_t name) {
+    uint32_t h = name;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// distance of slot n from the home slot of hash h
+#define PROBELEN(stab, n, h) (((n) - (h)) & ((stab)->slotqty - 1))
 
-static inline int hash(char *key) {
-    if (!key) {
-        panic("BAD_HASH_KEY");
+static syment_t* getsym(symtab_t *stab, atom_t name) {
+    if (!stab->named) {
+        return NULL;
     }
 
-    int h, i;
-    for (i = h = 0; key[i] != '\0'; i++) {
-        h = ((h << HASHSHIFT) + key[i]) % HASHSIZE;
+    uint32_t mask = stab->slotqty - 1;
+    uint32_t h = symhash(name);
+    for (uint32_t n = h & mask, dist = 0;; n = (n + 1) & mask, dist++) {
+        symslot_t *s = &stab->slots[n];
+        if (s->e == NULL || PROBELEN(stab, n, s->hash) < dist) {
+            return NULL;
+        }
+        if (s->hash == h) {
+            return s->e;
+        }
     }
+}
 
-    return h;
+static void slotput(symtab_t *stab, symslot_t cur) {
+    uint32_t mask = stab->slotqty - 1;
+    for (uint32_t n = cur.hash & mask, dist = 0;; n = (n + 1) & mask, dist++) {
+        symslot_t *s = &stab->slots[n];
+        if (s->e == NULL) {
+            *s = cur;
+            ++stab->named;
+            return;
+        }
+        // a redeclared name shadows the old entry
+        if (s->hash == cur.hash) {
+            s->e = cur.e;
+            return;
+        }
+        uint32_t sdist = PROBELEN(stab, n, s->hash);
+        if (sdist < dist) {
+            symslot_t t = *s;
+            *s = cur;
+            cur = t;
+            dist = sdist;
+        }
+    }
 }
 
-static syment_t* getsym(symtab_t *stab, char *name) {
-    syment_t *hair, *e;
-    hair = &stab->buckets[hash(name) % MAXBUCKETS];
-    for (e = hair->next; e; e = e->next) {
-        if (!strcmp(e->name, name)) {
-            return e;
+// index entry name, growing at 3/4 load
+static void indexsym(symtab_t *stab, syment_t *e) {
+    if ((stab->named + 1) * 4 > stab->slotqty * 3) {
+        symslot_t *old = stab->slots;
+        uint32_t qty = stab->slotqty;
+
+        // old slots stay in the arena, the geometric growth bounds the waste
+        stab->slotqty = qty ? qty * 2 : MINSLOTS;
+        stab->slots = arena_alloc(SYMTAB_ARENA, stab->slotqty * sizeof(symslot_t));
+        stab->named = 0;
+        for (uint32_t n = 0; n < qty; n++) {
+            if (old[n].e) {
+                slotput(stab, old[n]);
+            }
         }
     }
-    return NULL;
+
+    symslot_t s = { symhash(e->name), e };
+    slotput(stab, s);
 }
 
+// append entry to the scope
 static void putsym(symtab_t *stab, syment_t *e) {
-    syment_t *hair = &stab->buckets[hash(e->name) % MAXBUCKETS];
-    e->next = hair->next;
-    hair->next = e;
-
-    // for debugging
-    if (e->sid + 1 >= MAXSYMENT) {
-        panic("TOO_MANY_SYMBOL_ENTRY");
+    if (stab->etail) {
+        stab->etail->next = e;
+    } else {
+        stab->ehead = e;
     }
-    syments[e->sid] = e;
+    stab->etail = e;
 
-    dbg("tid=%d nspace=%s sym=%s\n", stab->tid, stab->nspace, e->name);
+    dbg("tid=%d nspace=%s sym=%s\n", stab->tid, atom_str(stab->nspace), atom_str(e->name));
 }
 
 static void dumptab(symtab_t *stab) {
@@ -135,29 +212,33 @@ static void dumptab(symtab_t *stab) {
     }
 
     symtab_t *t = stab;
-    msg("%sstab(tid=%d): depth=%d, nspace=%s\n", indent, t->tid, t->depth, t->nspace);
+    msg("%sstab(tid=%d): depth=%d, nspace=%s\n", indent, t->tid, t->depth, atom_str(t->nspace));
 
     strcat(indent, "  ");
-    for (i = 0; i < MAXBUCKETS; ++i) {
-        syment_t *hair, *e;
-        hair = &t->buckets[i];
-        for (e = hair->next; e; e = e->next) {
-            msg("%ssid=%d, name=%s, cate=%d, type=%d, value=%ld, label=%s\n", indent, e->sid, e->name, e->cate, e->type, e->initval, e->label);
-        }
+    for (syment_t *e = t->ehead; e; e = e->next) {
+        msg("%ssid=%d, name=%s, cate=%d, type=%d, value=%ld, label=%s\n", indent, e->sid, atom_str(e->name), e->cate, e->type, e->initval,
+                symlabel(e));
+    }
+    for (i = 0; i < t->tmpoff; ++i) {
+        msg("%stemp id=%d, name=%s, type=%d, label=%s\n", indent, t->temps[i].id, atom_str(t->temps[i].text), t->temps[i].type,
+                mklabel(TEMP_OBJ, t->temps[i].id));
+    }
+    for (i = 0; i < t->strqty; ++i) {
+        msg("%sstring id=%d, label=%s, value=\"%s\"\n", indent, t->strs[i].id, mklabel(STRING_OBJ, t->strs[i].id), atom_str(t->strs[i].text));
     }
     msg("%sargoff: %d, varoff: %d, tmpoff: %d\n", indent, stab->argoff, stab->varoff, stab->tmpoff);
 }
 
-syment_t* symget(char *name) {
+syment_t* symget(atom_t name) {
     nevernil(top);
     return getsym(top, name);
 }
 
-syment_t* symget2(symtab_t *stab, char *name) {
+syment_t* symget2(symtab_t *stab, atom_t name) {
     return getsym(stab, name);
 }
 
-syment_t* symfind(char *name) {
+syment_t* symfind(atom_t name) {
     nevernil(top);
     syment_t *e;
     symtab_t *t;
@@ -177,6 +258,7 @@ void symadd(syment_t *entry) {
 void symadd2(symtab_t *stab, syment_t *entry) {
     nevernil(stab);
     putsym(stab, entry);
+    indexsym(stab, entry);
     entry->stab = stab;
 }
 
@@ -193,12 +275,12 @@ syment_t* syminit(ident_node_t *idp) {
     return syminit2(top, idp, idp->name);
 }
 
-syment_t* syminit2(symtab_t *stab, ident_node_t *idp, char *key) {
+syment_t* syminit2(symtab_t *stab, ident_node_t *idp, atom_t key) {
     syment_t *e;
     NEWENTRY(e);
     e->sid = ++sidcnt;
 
-    strcopy(e->name, key);
+    e->name = key;
     e->initval = idp->value;
     e->arrlen = idp->length;
     e->lineno = idp->line;
@@ -273,28 +355,23 @@ syment_t* syminit2(symtab_t *stab, ident_node_t *idp, char *key) {
     switch (e->cate) {
         case NOP_OBJ:
         case CONSTANT_OBJ:
-            sprintf(e->label, "CNS%03d", e->sid);
             // no need allocation
             break;
         case VARIABLE_OBJ:
-            sprintf(e->label, "VBL%03d", e->sid);
             e->off = stab->varoff;
             stab->varoff++;
             break;
         case PROC_OBJ:
         case FUNCTION_OBJ:
-            sprintf(e->label, "FUN%03d", e->sid);
             e->off = stab->varoff;
             stab->varoff++;
             break;
         case BY_VALUE_OBJ:
         case BY_REFERENCE_OBJ:
-            sprintf(e->label, "VAL%03d", e->sid);
             e->off = stab->argoff;
             stab->argoff++;
             break;
         case ARRAY_OBJ:
-            sprintf(e->label, "ARR%03d", e->sid);
             e->off = stab->varoff;
             stab->varoff += e->arrlen;
             break;
@@ -306,38 +383,152 @@ syment_t* syminit2(symtab_t *stab, ident_node_t *idp, char *key) {
     return e;
 }
 
-syment_t* symalloc(symtab_t *stab, char *name, cate_t cate, type_t type) {
-    syment_t *e;
-    NEWENTRY(e);
-    strcopy(e->name, name);
-    e->sid = ++sidcnt;
+// append to a scope temporary list, growing it in the arena
+static tmpent_t* tmpput(tmpent_t **list, int qty, int *cap) {
+    if (qty == *cap) {
+        *cap = *cap ? *cap * 2 : MINSLOTS;
+        tmpent_t *grown = arena_alloc(SYMTAB_ARENA, *cap * sizeof(tmpent_t));
+        if (qty) {
+            memcpy(grown, *list, qty * sizeof(tmpent_t));
+        }
+        *list = grown;
+    }
+    return &(*list)[qty];
+}
 
-    e->cate = cate;
-    e->type = type;
+int symtemp(symtab_t *stab, char *name, type_t type) {
+    // from now on, we will NEVER alloc local variables so just
+    // alloc temporary variables
+    tmpent_t *t = tmpput(&stab->temps, stab->tmpoff, &stab->tmpcap);
+    t->id = ++sidcnt;
+    t->type = type;
+    t->text = atom_cstr(name);
+    stab->tmpoff++;
+    return t->id;
+}
 
-    switch (e->cate) {
-        case NUMBER_OBJ:
-            sprintf(e->label, "LIT%03d", e->sid);
-            break;
-        case TEMP_OBJ:
-            // from now on, we will NEVER alloc local variables so just
-            // alloc temporary variables
-            sprintf(e->label, "TMP%03d", e->sid);
-            e->off = stab->varoff + stab->tmpoff;
-            stab->tmpoff++;
-            break;
-        case LABEL_OBJ:
-            sprintf(e->label, "LBL%03d", e->sid);
-            break;
-        case STRING_OBJ:
-            sprintf(e->label, "TMP%03d", e->sid);
-            // label/number/string never use bytes
-            break;
-        default:
-            unlikely();
+int symstring(symtab_t *stab, atom_t str) {
+    // strings never use bytes
+    tmpent_t *t = tmpput(&stab->strs, stab->strqty, &stab->strcap);
+    t->id = ++sidcnt;
+    t->type = STRING_TYPE;
+    t->text = str;
+    stab->strqty++;
+    return t->id;
+}
+
+static double elapsed(struct timespec *beg) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - beg->tv_sec) + (end.tv_nsec - beg->tv_nsec) / 1e9;
+}
+
+// hash of the chained table symtab used before the name index, for symbench()
+static int chainhash(const char *key) {
+    int h, i;
+    for (i = h = 0; key[i] != '\0'; i++) {
+        h = ((h << 4) + key[i]) % 211;
+    }
+    return h % 16;
+}
+
+void symbench(int qty) {
+    struct timespec beg;
+    char buf[MAXSTRLEN];
+    volatile long int sink = 0;
+    long int found = 0;
+
+    atom_t *hits = malloc(qty * sizeof(atom_t));
+    atom_t *misses = malloc(qty * sizeof(atom_t));
+    syment_t **ents = malloc(qty * sizeof(syment_t*));
+    if (!hits || !misses || !ents) {
+        panic("OUT_OF_MEMORY");
+    }
+    for (int i = 0; i < qty; i++) {
+        hits[i] = atom_intern(buf, snprintf(buf, MAXSTRLEN, "v%d", i));
+        misses[i] = atom_intern(buf, snprintf(buf, MAXSTRLEN, "w%d", i));
     }
 
-    e->stab = stab;
-    putsym(stab, e);
-    return e;
+    for (int i = 0; i < qty; i++) {
+        NEWENTRY(ents[i]);
+        ents[i]->name = hits[i];
+    }
+
+    // one scope holding every symbol
+    symtab_t *stab;
+    NEWSTAB(stab);
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i++) {
+        putsym(stab, ents[i]);
+        indexsym(stab, ents[i]);
+    }
+    double insert = elapsed(&beg);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i++) {
+        found += getsym(stab, hits[i]) == ents[i];
+    }
+    double hit = elapsed(&beg);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i++) {
+        found += getsym(stab, misses[i]) != NULL;
+    }
+    double miss = elapsed(&beg);
+    sink += found;
+
+    uint32_t maxprobe = 0;
+    double probes = 0;
+    for (uint32_t n = 0; n < stab->slotqty; n++) {
+        if (stab->slots[n].e) {
+            uint32_t dist = PROBELEN(stab, n, stab->slots[n].hash);
+            probes += dist;
+            maxprobe = dist > maxprobe ? dist : maxprobe;
+        }
+    }
+
+    printf("; symtab %d symbols, %u slots, load %.2f, probe avg %.2f max %u\n", qty, stab->slotqty, (double) stab->named / stab->slotqty,
+            probes / stab->named, maxprobe);
+    printf("; symtab open addressing: insert %.1f ns, hit %.1f ns, miss %.1f ns\n", insert * 1e9 / qty, hit * 1e9 / qty, miss * 1e9 / qty);
+
+    // the 16 chained buckets with strcmp, one lookup in 16 is enough to see it
+    syment_t *chains[16] = { NULL };
+    int sample = qty / 16 > 0 ? qty / 16 : 1;
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i++) {
+        int b = chainhash(atom_str(hits[i]));
+        ents[i]->next = chains[b];
+        chains[b] = ents[i];
+    }
+    insert = elapsed(&beg);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i += 16) {
+        for (syment_t *e = chains[chainhash(atom_str(hits[i]))]; e; e = e->next) {
+            if (!strcmp(atom_str(e->name), atom_str(hits[i]))) {
+                ++found;
+                break;
+            }
+        }
+    }
+    hit = elapsed(&beg);
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+    for (int i = 0; i < qty; i += 16) {
+        for (syment_t *e = chains[chainhash(atom_str(misses[i]))]; e; e = e->next) {
+            if (!strcmp(atom_str(e->name), atom_str(misses[i]))) {
+                ++found;
+                break;
+            }
+        }
+    }
+    miss = elapsed(&beg);
+    sink += found;
+
+    printf("; symtab 16 chained buckets: insert %.1f ns, hit %.1f ns, miss %.1f ns\n", insert * 1e9 / qty, hit * 1e9 / sample,
+            miss * 1e9 / sample);
+
+    free(hits);
+    free(misses);
+    free(ents);
 }
@@ -17,7 +17,9 @@
 
 #include <error.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "common.h"
 #include "global.h"
@@ -81,6 +83,184 @@ bool chkcmd(char *cmd) {
     return true;
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITS_X86
+#endif
+
+// bitset kernels of an instruction set
+typedef struct _bitsops_struct {
+    bool (*same)(bits_t a[], bits_t b[], int n);
+    void (*unite)(bits_t r[], bits_t a[], bits_t b[], int n);
+    void (*sub)(bits_t r[], bits_t a[], bits_t b[], int n);
+    bool (*transfer)(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n);
+} bitsops_t;
+
+static bool same_scalar(bits_t a[], bits_t b[], int n) {
+    bits_t diff = 0;
+    for (int i = 0; i < n; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return !diff;
+}
+
+static void unite_scalar(bits_t r[], bits_t a[], bits_t b[], int n) {
+    for (int i = 0; i < n; ++i) {
+        r[i] = a[i] | b[i];
+    }
+}
+
+static void sub_scalar(bits_t r[], bits_t a[], bits_t b[], int n) {
+    for (int i = 0; i < n; ++i) {
+        r[i] = a[i] & ~b[i];
+    }
+}
+
+static bool transfer_scalar(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n) {
+    bits_t diff = 0;
+    for (int i = 0; i < n; ++i) {
+        bits_t w = use[i] | (out[i] & ~def[i]);
+        diff |= w ^ r[i];
+        r[i] = w;
+    }
+    return diff != 0;
+}
+
+static const bitsops_t bits_scalar = { same_scalar, unite_scalar, sub_scalar, transfer_scalar };
+
+#ifdef BITS_X86
+
+// 2 words a lane, the odd word left goes scalar
+
+__attribute__((target("sse2")))
+static bool same_sse2(bits_t a[], bits_t b[], int n) {
+    __m128i diff = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((__m128i*) &a[i]), _mm_loadu_si128((__m128i*) &b[i])));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff && same_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void unite_sse2(bits_t r[], bits_t a[], bits_t b[], int n) {
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_si128((__m128i*) &r[i], _mm_or_si128(_mm_loadu_si128((__m128i*) &a[i]), _mm_loadu_si128((__m128i*) &b[i])));
+    }
+    unite_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void sub_sse2(bits_t r[], bits_t a[], bits_t b[], int n) {
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_si128((__m128i*) &r[i], _mm_andnot_si128(_mm_loadu_si128((__m128i*) &b[i]), _mm_loadu_si128((__m128i*) &a[i])));
+    }
+    sub_scalar(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static bool transfer_sse2(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n) {
+    __m128i diff = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i w = _mm_or_si128(_mm_loadu_si128((__m128i*) &use[i]),
+                _mm_andnot_si128(_mm_loadu_si128((__m128i*) &def[i]), _mm_loadu_si128((__m128i*) &out[i])));
+        diff = _mm_or_si128(diff, _mm_xor_si128(w, _mm_loadu_si128((__m128i*) &r[i])));
+        _mm_storeu_si128((__m128i*) &r[i], w);
+    }
+    bool changed = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff;
+    return transfer_scalar(r + i, use + i, out + i, def + i, n - i) || changed;
+}
+
+static const bitsops_t bits_sse2 = { same_sse2, unite_sse2, sub_sse2, transfer_sse2 };
+
+// 4 words a lane, the words left go SSE2. The upper halves are cleared
+// first, legacy SSE code on dirty ones pays a state transition
+
+__attribute__((target("avx2")))
+static bool same_avx2(bits_t a[], bits_t b[], int n) {
+    __m256i diff = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((__m256i*) &a[i]), _mm256_loadu_si256((__m256i*) &b[i])));
+    }
+    bool same = _mm256_testz_si256(diff, diff);
+    _mm256_zeroupper();
+    return same && same_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void unite_avx2(bits_t r[], bits_t a[], bits_t b[], int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_si256((__m256i*) &r[i], _mm256_or_si256(_mm256_loadu_si256((__m256i*) &a[i]), _mm256_loadu_si256((__m256i*) &b[i])));
+    }
+    _mm256_zeroupper();
+    unite_sse2(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void sub_avx2(bits_t r[], bits_t a[], bits_t b[], int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_si256((__m256i*) &r[i], _mm256_andnot_si256(_mm256_loadu_si256((__m256i*) &b[i]), _mm256_loadu_si256((__m256i*) &a[i])));
+    }
+    _mm256_zeroupper();
+    sub_sse2(r + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static bool transfer_avx2(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n) {
+    __m256i diff = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i w = _mm256_or_si256(_mm256_loadu_si256((__m256i*) &use[i]),
+                _mm256_andnot_si256(_mm256_loadu_si256((__m256i*) &def[i]), _mm256_loadu_si256((__m256i*) &out[i])));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(w, _mm256_loadu_si256((__m256i*) &r[i])));
+        _mm256_storeu_si256((__m256i*) &r[i], w);
+    }
+    bool changed = !_mm256_testz_si256(diff, diff);
+    _mm256_zeroupper();
+    return transfer_sse2(r + i, use + i, out + i, def + i, n - i) || changed;
+}
+
+static const bitsops_t bits_avx2 = { same_avx2, unite_avx2, sub_avx2, transfer_avx2 };
+
+#endif
+
+// kernels in use
+static const bitsops_t *bops = &bits_scalar;
+
+bitsisa_t bits_best(void) {
+#ifdef BITS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return BITS_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return BITS_SSE2;
+    }
+#endif
+    return BITS_SCALAR;
+}
+
+void bits_select(bitsisa_t isa) {
+    switch (isa) {
+#ifdef BITS_X86
+        case BITS_AVX2:
+            bops = &bits_avx2;
+            break;
+        case BITS_SSE2:
+            bops = &bits_sse2;
+            break;
+#endif
+        default:
+            bops = &bits_scalar;
+    }
+}
+
 // convert bit to char array
 void bconv(bin_t str, bits_t b) {
     int i = BITSIZE;
@@ -111,51 +291,187 @@ bool bget(bits_t bits[], int i) {
 
 // clear all bits
 void bclrall(bits_t bits[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        bits[i] &= 0;
-    }
+    memset(bits, 0, n * sizeof(bits_t));
 }
 
 // set all bits
 void bsetall(bits_t bits[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        bits[i] |= ~0;
-    }
+    memset(bits, 0xff, n * sizeof(bits_t));
 }
 
 // check if a[] and b[] is same
 bool bsame(bits_t a[], bits_t b[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        if (a[i] ^ b[i]) {
-            return false;
-        }
-    }
-    return true;
+    return bops->same(a, b, n);
 }
 
 // duplicate set
 void bdup(bits_t des[], bits_t src[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        des[i] = src[i];
-    }
+    memcpy(des, src, n * sizeof(bits_t));
 }
 
 // bits union: r = a union b
 void bunion(bits_t r[], bits_t a[], bits_t b[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        r[i] = a[i] | b[i];
-    }
+    bops->unite(r, a, b, n);
 }
 
 // bits substract: r = a substract b
 void bsub(bits_t r[], bits_t a[], bits_t b[], int n) {
-    int i;
-    for (i = 0; i < n; ++i) {
-        r[i] = a[i] & (~b[i]);
+    bops->sub(r, a, b, n);
+}
+
+bool btransfer(bits_t r[], bits_t use[], bits_t out[], bits_t def[], int n) {
+    return bops->transfer(r, use, out, def, n);
+}
+
+int bcount(bits_t bits[], int n) {
+    int cnt = 0;
+    for (int i = 0; i < n; ++i) {
+        cnt += __builtin_popcountll(bits[i]);
+    }
+    return cnt;
+}
+
+int bnext(bits_t bits[], int n, int i) {
+    int pos = POS(i);
+    if (pos >= n) {
+        return -1;
+    }
+
+    // bits below i in its word are masked off
+    bits_t w = bits[pos] & (~(bits_t) 0 << OFF(i));
+    while (!w) {
+        if (++pos == n) {
+            return -1;
+        }
+        w = bits[pos];
+    }
+    return pos * BITSIZE + __builtin_ctzll(w);
+}
+
+// xorshift64, the same sets on every run
+static bits_t bench_rand(bits_t *seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+// random words, some empty or full, so equal lanes and carries show up
+static void bench_fill(bits_t bits[], int n, bits_t *seed) {
+    for (int i = 0; i < n; ++i) {
+        switch (bench_rand(seed) % 4) {
+            case 0:
+                bits[i] = 0;
+                break;
+            case 1:
+                bits[i] = ~(bits_t) 0;
+                break;
+            default:
+                bits[i] = bench_rand(seed);
+        }
+    }
+}
+
+static double elapsed(struct timespec *beg) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - beg->tv_sec) + (end.tv_nsec - beg->tv_nsec) / 1e9;
+}
+
+// sets of 0 to BENCH_WORDS words checked, BENCH_SETS each
+#define BENCH_WORDS 22
+#define BENCH_SETS  1000
+// words of the timed sets
+#define BENCH_TIMED 64
+
+int bitsbench(void) {
+    static const char *isa_names[] = { "scalar", "sse2", "avx2" };
+    bits_t a[BENCH_TIMED], b[BENCH_TIMED], c[BENCH_TIMED], r[BENCH_TIMED], s[BENCH_TIMED];
+    int failed = 0;
+
+    // set size and walk against bget()
+    bits_t seed = 0x9e3779b97f4a7c15ull;
+    long int checks = 0, errors = 0;
+    for (int n = 0; n <= BENCH_WORDS; ++n) {
+        for (int k = 0; k < BENCH_SETS; ++k, ++checks) {
+            bench_fill(a, n, &seed);
+            int cnt = 0, next = bnext(a, n, 0);
+            for (int i = 0; i < n * BITSIZE; ++i) {
+                if (!bget(a, i)) {
+                    continue;
+                }
+                errors += next != i;
+                next = bnext(a, n, i + 1);
+                ++cnt;
+            }
+            errors += next != -1 || bcount(a, n) != cnt;
+        }
+    }
+    printf("; bits count/next %ld sets, %ld mismatches\n", checks, errors);
+    failed += errors;
+
+    // every kernel against the scalar one, on the same sets
+    for (bitsisa_t isa = BITS_SCALAR; isa <= bits_best(); isa++) {
+        bits_select(isa);
+        seed = 0x9e3779b97f4a7c15ull;
+        checks = errors = 0;
+        for (int n = 0; n <= BENCH_WORDS; ++n) {
+            for (int k = 0; k < BENCH_SETS; ++k, ++checks) {
+                bench_fill(a, n, &seed);
+                bench_fill(b, n, &seed);
+                bench_fill(c, n, &seed);
+
+                // b equal to a but a word at times
+                if (k % 2 && n) {
+                    bdup(b, a, n);
+                    if (k % 4 == 1) {
+                        b[bench_rand(&seed) % n] ^= MASK(bench_rand(&seed));
+                    }
+                }
+                errors += bsame(a, b, n) != same_scalar(a, b, n);
+
+                bunion(r, a, b, n);
+                unite_scalar(s, a, b, n);
+                errors += memcmp(r, s, n * sizeof(bits_t)) != 0;
+
+                bsub(r, a, b, n);
+                sub_scalar(s, a, b, n);
+                errors += memcmp(r, s, n * sizeof(bits_t)) != 0;
+
+                // r starts as the result at times, to see it unchanged
+                transfer_scalar(s, a, b, c, n);
+                if (k % 3) {
+                    bench_fill(r, n, &seed);
+                } else {
+                    bdup(r, s, n);
+                }
+                bdup(s, r, n);
+                bool changed = btransfer(r, a, b, c, n);
+                errors += changed != transfer_scalar(s, a, b, c, n);
+                errors += memcmp(r, s, n * sizeof(bits_t)) != 0;
+            }
+        }
+
+        // the LVA inner step on sets of BENCH_TIMED words
+        struct timespec beg;
+        volatile long int sink = 0;
+        long int sum = 0;
+        int rounds = 1000000;
+        bench_fill(a, BENCH_TIMED, &seed);
+        bench_fill(b, BENCH_TIMED, &seed);
+        bench_fill(c, BENCH_TIMED, &seed);
+        clock_gettime(CLOCK_MONOTONIC, &beg);
+        for (int k = 0; k < rounds; ++k) {
+            b[k % BENCH_TIMED] ^= 1;
+            sum += btransfer(r, a, b, c, BENCH_TIMED);
+        }
+        double secs = elapsed(&beg);
+        sink += sum;
+
+        printf("; bits %-6s %ld sets of 0 to %d words, %ld mismatches, transfer %.1f ns per %d words\n", isa_names[isa], checks,
+                BENCH_WORDS, errors, secs * 1e9 / rounds, BENCH_TIMED);
+        failed += errors;
     }
+    bits_select(BITS_SCALAR);
+    return failed;
 }
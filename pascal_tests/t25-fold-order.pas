@@ -0,0 +1,17 @@
+{ identity folds on a variable that a later call in the expression writes }
+var x: integer;
+
+function f(): integer;
+begin
+   x := 100;
+   f := 1
+end;
+
+begin
+   x := 5; write(x + 0 + f());
+   x := 5; write(x * 1 + f());
+   x := 5; write(x - 0 + f());
+   x := 5; write(0 + x + f());
+   x := 5; write(1 * x + f());
+   x := 5; write(x / 1 + f());
+end.
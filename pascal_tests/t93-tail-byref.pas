@@ -0,0 +1,23 @@
+{ tail call under a guard whose variable a call writes by reference }
+procedure setv(var x: integer);
+begin
+   x := 0
+end;
+
+function h(n, k: integer): integer;
+var m: integer;
+begin
+   m := n;
+   h := 100;
+   if m > k then
+   begin
+      setv(m);
+      h := h(n - 5, k + 10)
+   end;
+   if m < k then h := k;
+end;
+
+begin
+   write(h(5, 3));
+   write(h(2, 3));
+end.
@@ -0,0 +1,10 @@
+#! /bin/bash
+#
+# bitset kernels: every instruction set against the scalar one, and the
+# LVA transfer step timed
+#   usage: bitsbench.sh [compiler]
+
+PC=${1:-Release/stack_vm_pascal}
+
+# the driver wants an input file, the benchmark does not read it
+$PC -bits-bench "$(dirname "$0")"/../pascal_tests/t02-hello.pas
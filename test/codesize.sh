@@ -0,0 +1,19 @@
+#! /bin/bash
+#
+# stackvm code size and frame slots of pascal_tests at each -O level
+#   usage: codesize.sh [compiler] [tests directory]
+
+PC=$(realpath ${1:-Release/stack_vm_pascal})
+TESTS=$(realpath ${2:-pascal_tests})
+WORK=$(mktemp -d)
+
+cd "$WORK"
+for level in -O0 -O1 -O2; do
+    for f in "$TESTS"/*.pas; do
+        cp "$f" .
+        $PC $level $(basename "$f")
+    done | awk -v level=$level '/^; stackvm/ { i += $3; b += $5; s += $7; t += $10 }
+        END { printf("%s %7d instructions, %7d bytes, %5d frame slots, %5d stacked temps\n", level, i, b, s, t) }'
+done
+cd - > /dev/null
+rm -rf "$WORK"
@@ -0,0 +1,41 @@
+#! /bin/bash
+#
+# assembling and optimizer time on a large generated program
+#   usage: irbench.sh [compiler] [procedures] [statements per procedure]
+
+PC=${1:-Release/stack_vm_pascal}
+PROCS=${2:-333}
+STMTS=${3:-50}
+INPUT=$(mktemp --suffix=.pas)
+
+# procedures of short blocks: arithmetic, branches and array stores,
+# about 8 instructions per statement
+{
+    echo "var g: integer;"
+    for ((p = 0; p < PROCS; p++)); do
+        echo "procedure p$p(n: integer);"
+        echo "var x, y, z: integer; a: array[16] of integer;"
+        echo "begin"
+        echo "  x := n; y := 2; z := 3;"
+        for ((n = 0; n < STMTS; n++)); do
+            case $((n % 4)) in
+                0) echo "  if x > $((n % 97)) then y := y + x * 2 else z := z - y;" ;;
+                1) echo "  x := (x + y) * (z - $((n % 13))) / 3;" ;;
+                2) echo "  a[$((n % 16))] := x + a[$(((n + 1) % 16))];" ;;
+                3) echo "  if z <> y then x := x - 1;" ;;
+            esac
+        done
+        echo "  g := g + x"
+        echo "end;"
+    done
+    echo "begin"
+    echo "  g := 0;"
+    for ((p = 0; p < PROCS; p++)); do
+        echo "  p$p($p);"
+    done
+    echo "  write(g)"
+    echo "end."
+} > "$INPUT"
+
+$PC -ir-bench "$INPUT"
+rm -f "$INPUT"
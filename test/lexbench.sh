@@ -0,0 +1,19 @@
+#! /bin/bash
+#
+# lexing throughput on a large generated input
+#   usage: lexbench.sh [compiler] [copies]
+
+PC=${1:-Release/stack_vm_pascal}
+COPIES=${2:-2000}
+INPUT=$(mktemp --suffix=.pas)
+
+# generated sources carry a comment header
+HEADER=$(printf '{\n'; for ((l = 0; l < 40; l++)); do printf ' * generated source, copyright and license notice, line %02d\n' $l; done; printf '}\n')
+
+for ((n = 0; n < COPIES; n++)); do
+    echo "$HEADER"
+    cat "$(dirname "$0")"/../pascal_tests/*.pas
+done > "$INPUT"
+
+$PC -lex-bench "$INPUT"
+rm -f "$INPUT"
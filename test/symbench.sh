@@ -0,0 +1,9 @@
+#! /bin/bash
+#
+# symbol table throughput, 100k symbols in one scope
+#   usage: symbench.sh [compiler]
+
+PC=${1:-Release/stack_vm_pascal}
+
+# the driver wants an input file, the benchmark does not read it
+$PC -symtab-bench "$(dirname "$0")"/../pascal_tests/t02-hello.pas
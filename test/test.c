@@ -18,6 +18,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "arena.h"
+#include "atom.h"
 #include "init.h"
 #include "anlysis.h"
 #include "irassembler.h"
@@ -26,23 +28,48 @@
 #include "scan.h"
 #include "parse.h"
 #include "irasm_to_stackvm.h"
+#include "optimize.h"
+#include "symtab.h"
+#include "util.h"
 
-void **memtrack;
-unsigned long memtrack_qty;
+// symbols in the -symtab-bench scope
+#define SYMBENCH_QTY 100000
 
 int main(int argc, char *argv[]) {
     pgm_node_t *res = NULL;
-    memtrack = malloc(sizeof(void*));
-    memtrack_qty = 0;
     asm_result_t *irasm = calloc(1, sizeof(asm_result_t));
     uint32_t irasm_len = 0;
-    asm_result_t* stackvm_asm = malloc(1);
-    uint32_t stackvm_asm_len = 0;
+    stackvm_program_t program = { 0 };
 
 
     // initial
     init(argc, argv);
 
+    // lexing throughput only
+    if (PL0E_OPT_LEX_BENCH) {
+        scan_open();
+        lexbench();
+        scan_close();
+        free(irasm);
+        return 0;
+    }
+
+    // symbol table throughput only
+    if (PL0E_OPT_SYMTAB_BENCH) {
+        symbench(SYMBENCH_QTY);
+        arena_release(SYMTAB_ARENA);
+        atom_free();
+        free(irasm);
+        return 0;
+    }
+
+    // bitset kernels only
+    if (PL0E_OPT_BITS_BENCH) {
+        int mismatches = bitsbench();
+        free(irasm);
+        return mismatches ? 1 : 0;
+    }
+
     // lexical & syntax
     parse(&res);
 
@@ -51,20 +78,41 @@ int main(int argc, char *argv[]) {
 
     // generate IR
     genir(res);
+    arena_release(AST_ARENA);
+
+    // assembling and optimizer throughput only
+    if (PL0E_OPT_IR_BENCH) {
+        irbench();
+        arena_release(OPTIM_ARENA);
+        arena_release(IR_ARENA);
+        ir_free();
+        arena_release(SYMTAB_ARENA);
+        atom_free();
+        free(irasm);
+        return 0;
+    }
+
+    // optimize, as the -O level asks
+    optim();
 
     // generate target code
     irasm_len = gen_irasm(&irasm);
     print_irasm(irasm, irasm_len);
     print_ir_fn_elements();
+    arena_release(OPTIM_ARENA);
+    arena_release(IR_ARENA);
+    ir_free();
+    arena_release(SYMTAB_ARENA);
+    atom_free();
 
-    // generate stackvm asm
-    irasm_to_stackvm(irasm, irasm_len, &stackvm_asm, &stackvm_asm_len);
+    // generate stackvm program
+    irasm_to_stackvm(irasm, irasm_len, &program);
+    stackvm_write(&program, PL0E_TARGET);
+    arena_release(ASM_ARENA);
 
     // free assembler
+    stackvm_free(&program);
     free_irasm();
-    for (unsigned long n = 0; n < memtrack_qty; n++)
-        free(memtrack[n]);
-    free(memtrack);
     free(irasm);
 
     return 0;